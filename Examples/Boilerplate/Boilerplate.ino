@@ -35,6 +35,8 @@ void setup() {
   
   robobrrd.setAutoDetach(true); // setting the servos to detach after movements
   
+  //robobrrd.setEyesGamma(false); // uncomment for the eye colours from before gamma correction
+  
   addPromulgateCallbacks(); // add in our callbacks for the API
   
   addLightCallbacks(); // setting our callbacks for the light sensors
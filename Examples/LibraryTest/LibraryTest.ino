@@ -29,7 +29,6 @@
 
 RoboBrrd robobrrd;
 
-long last_blink = 0;
 uint8_t instruction_advance = 0;
 uint8_t prev_instr = 0;
 
@@ -51,6 +50,9 @@ void setup() {
   
   Serial << "Hey there! Chirpy chirp!" << endl;
   
+  robobrrd.setEyesHSI(0.0, 0.0, 1.0);
+  robobrrd.blinkEyes(950, 50, 0.6, 0); // blink every second, forever (update() does the work)
+  
   // if you need to adjust your servo positions afterwards, uncomment this
   // block of code and add in the proper settings!
   //robobrrd.setServoDefaults(RoboBrrd::ROTATION_SERVO, 90, 0, 180); // home, left, right
@@ -134,16 +136,19 @@ void loop() {
       case 13:
         Serial << "Red eyes" << endl;
         robobrrd.setEyesRGB(255, 0, 0);
+        robobrrd.blinkEyes(950, 50, 0.6, 0);
         delay(100);
       break;
       case 14:
         Serial << "Green eyes" << endl;
         robobrrd.setEyesRGB(0, 255, 0);
+        robobrrd.blinkEyes(950, 50, 0.6, 0);
         delay(100);
       break;
       case 15:
         Serial << "Blue eyes" << endl;
         robobrrd.setEyesRGB(0, 0, 255);
+        robobrrd.blinkEyes(950, 50, 0.6, 0);
         delay(100);
       break;
     }
@@ -157,14 +162,6 @@ void loop() {
   robobrrd.update(); // keepin' robobrrd alive each loop iteration
   
   
-  if(millis()-last_blink >= 1000) {
-    robobrrd.setEyesHSI(0.0, 0.0, 0.6);
-    delay(50);
-    robobrrd.setEyesHSI(0.0, 0.0, 1.0);
-    last_blink = millis();
-  }
-  
-  
 }
 
 
@@ -34,5 +34,11 @@ static const uint8_t mood_addr[] = {15, 16};
 // state: food, water, play
 static const uint8_t state_addr[] = {17, 18, 19};
 
+// light sensor calibration: a stamp, then 2 bytes (low, high) for each
+// channel's baseline, then each channel's min raw, max raw, dark threshold
+// and bright threshold, and a checksum at the end. that's 20-41 for 2
+// channels, and 10 more bytes for each channel after that
+static const uint8_t ldr_cal_addr = 20;
+
 // used to show that this has been initialised
 static const uint8_t init_addr = 99;
\ No newline at end of file
@@ -5,6 +5,11 @@
 
  #include "RoboBrrd.h"
 
+// older versions of avr-libc don't have pgm_read_ptr
+#ifndef pgm_read_ptr
+	#define pgm_read_ptr(addr) (void *)pgm_read_word(addr)
+#endif
+
 /**
  * Initialisation
  */
@@ -14,6 +19,14 @@ RoboBrrd::RoboBrrd() {
  	debug_stream = &Serial;
  	LOG_LEVEL = ERROR_;
  	light_sensors_enabled = true;
+ 	background_adc = false;
+ 	async_motion = false;
+ 	motionComplete = NULL;
+ 	for(uint8_t i=0; i<NUM_LDRS; i++) {
+ 		ldrDark[i] = NULL;
+ 		ldrBright[i] = NULL;
+ 		ldrNormal[i] = NULL;
+ 	}
  	
  }
 
@@ -32,22 +45,35 @@ bool RoboBrrd::init() {
 	led_pins[1] = 6;
 	led_pins[2] = 5;
 	spkr_pin = A4;
-	ldr_left_pin = A0;
-	ldr_right_pin = A1;
+	for(uint8_t i=0; i<NUM_LDRS; i++) {
+		ldr_pins[i] = A0 + i;
+	}
 
 
 	auto_detach = false;
 
-	MAX_BRIGHTNESS = 1.0;
+	max_brightness = 255;
+	eyes_gamma = true;
+	eyes_dither = false;
+	last_dither = 0;
+	for(uint8_t i=0; i<3; i++) {
+		led_in12[i] = 0;
+		led_out12[i] = 0;
+		led_dither_acc[i] = 0;
+	}
 
 
 	// add all the pins as outputs
-	pinMode(led_pins[0], OUTPUT);
-	pinMode(led_pins[1], OUTPUT);
-	pinMode(led_pins[2], OUTPUT);
-	pinMode(spkr_pin, OUTPUT);
-	pinMode(ldr_left_pin, INPUT);
-	pinMode(ldr_right_pin, INPUT);
+	hal_pinMode(led_pins[0], OUTPUT);
+	hal_pinMode(led_pins[1], OUTPUT);
+	hal_pinMode(led_pins[2], OUTPUT);
+	hal_pinMode(spkr_pin, OUTPUT);
+	for(uint8_t i=0; i<NUM_LDRS; i++) {
+		hal_pinMode(ldr_pins[i], INPUT);
+	}
+
+	// now that the pins are known
+	enableBackgroundADC(background_adc);
 
 
 	// if the eeprom memory isn't loaded yet, we should put some data there
@@ -77,7 +103,7 @@ bool RoboBrrd::init() {
 		saveState();
 
 		// it is initialised now, let's flip the switch!
-		EEPROM.write(init_addr, true);
+		hal_eepromWrite(init_addr, true);
 
 		if(LOG_LEVEL <= DEBUG) Serial << "......Done" << endl; 
 
@@ -90,9 +116,60 @@ bool RoboBrrd::init() {
 	for(uint8_t i=0; i<4; i++) {
 		last_servo_move[i] = 0;
 		last_servo_pos[i] = 0;
-		last_servos_moved[i] = 0;
+		servo_power[i] = SERVO_DETACHED;
+		servo_hold_time[i] = AUTO_DETACH_TIMER;
+		servo_attaches[i] = 0;
+		servo_detaches[i] = 0;
+	}
+
+	// motion scheduler
+	for(uint8_t i=0; i<MOTION_PRIORITIES; i++) {
+		motion_head[i] = 0;
+		motion_count[i] = 0;
 	}
-	last_servos_moved[4] = 0; // because this is the size of 5 elements, not 4
+	motion_overflows = 0;
+	motion_preemptions = 0;
+	motion_busy = false;
+	motion_step_start = 0;
+	motion_step_del = 0;
+	gesture_ptr = NULL;
+	gesture_pc = 0;
+	gesture_looping = false;
+	gesture_loops_left = 0;
+
+	// choreography
+	for(uint8_t i=0; i<2; i++) {
+		choreo_len[i] = 0;
+		choreo_ready[i] = false;
+	}
+	choreo_play_buf = 0;
+	choreo_fill_buf = 0;
+	choreo_pos = 0;
+	choreo_playing = false;
+	choreo_starving = false;
+	choreo_last_step = 0;
+	choreo_wait = 0;
+	choreo_stream = 0;
+	choreo_starved = 0;
+	choreo_dropped = 0;
+
+	// trajectories
+	for(uint8_t i=0; i<4; i++) {
+		traj_pos[i] = 0;
+		traj_target[i] = 0;
+		traj_vel[i] = 0;
+		traj_max_vel[i] = 0;
+		traj_accel[i] = 0;
+		traj_out[i] = 0;
+		traj_ticks_left[i] = 0;
+	}
+	traj_active_mask = 0;
+	traj_timed_mask = 0;
+	traj_known_mask = 0;
+	traj_dirty_mask = 0;
+	servo_writes = 0;
+	servo_writes_suppressed = 0;
+	last_traj_tick = 0;
 
 	for(uint8_t i=0; i<3; i++) {
 		rot_pos[i] = 0;
@@ -105,11 +182,42 @@ bool RoboBrrd::init() {
 	// leds
 	for(uint8_t i=0; i<3; i++) {
 		last_led_hsi[i] = 0.0;
-		current_hsi[i] = 0.0;
 		last_led_rgb[i] = 0;
 		current_rgb[i] = 0;
+		eye_from[i] = 0;
+		eye_to[i] = 0;
 	}
 
+	current_hue = 0;
+	current_sat = 0;
+	current_int = 0;
+	current_hsi_valid = true;
+
+	tone_head = 0;
+	tone_count = 0;
+	tone_overflows = 0;
+	tone_started = false;
+	next_tone = 0;
+	chirp_attack = 5;
+	chirp_release = 15;
+	chirp_volume = 255;
+
+	melody_ptr = NULL;
+	melody_pc = 0;
+	melody_unit = 0;
+	melody_looping = false;
+	melody_loops_left = 0;
+
+	eye_anim = EYES_STILL;
+	eye_anim_start = 0;
+	last_eye_frame = 0;
+	eye_anim_time = 0;
+	eye_anim_time2 = 0;
+	eye_anim_times = 0;
+	eye_anim_level = 0;
+	eye_from_h = 0;
+	eye_to_h = 0;
+
 
 	// ldrs
 
@@ -118,32 +226,46 @@ bool RoboBrrd::init() {
 
 	// sample related
 	last_sampled = 0;
-	sample_count = 0;
-	ldr_left_total = 0;
-	ldr_right_total = 0;
+	sample_pos = 0;
+	sample_fill = 0;
+	window_count = 0;
+	window_start = 0;
+	window_steady = true;
+	sample_time = FAST_TIME_THRESH;
+	sample_time_min = FAST_TIME_THRESH;
+	sample_time_max = TIME_THRESH;
 	done_calibration = false;
+	light_calibration = LIGHT_CALIBRATED;
+	calibration_start = 0;
+	calibration_blink = false;
+	last_calibration_save = 0;
+
+	for(uint8_t ch=0; ch<NUM_LDRS; ch++) {
+
+		for(uint8_t i=0; i<SAMPLE_SIZE; i++) {
+			ldr_ring[ch][i] = 0;
+		}
+		ldr_total[ch] = 0;
 
-	// raw vals
-	current_ldr_left_raw = 0;
-	current_ldr_right_raw = 0;
-	previous_ldr_left_raw = 0;
-	previous_ldr_right_raw = 0;
-	ldr_left_min_raw = 0;
-	ldr_left_max_raw = 0;
-	ldr_right_min_raw = 0;
-	ldr_right_max_raw = 0;
-
-	// averaged vals
-	current_ldr_left_val = 0;
-	current_ldr_right_val = 0;
-	previous_ldr_left_val = 0;
-	previous_ldr_right_val = 0;
-
-	// trigger related
-	left_dark_thresh = 0;
-	left_bright_thresh = 0;
-	right_dark_thresh = 0;
-	right_bright_thresh = 0;
+		// raw vals
+		current_ldr_raw[ch] = 0;
+		previous_ldr_raw[ch] = 0;
+		ldr_min_raw[ch] = 0;
+		ldr_max_raw[ch] = 0;
+
+		// averaged vals
+		current_ldr_val[ch] = 0;
+		previous_ldr_val[ch] = 0;
+
+		// trigger related
+		dark_thresh[ch] = 0;
+		bright_thresh[ch] = 0;
+
+		ldr_state[ch] = LDR_NORMAL;
+		trigger_sample[ch] = 0;
+		last_trigger[ch] = 0;
+
+	}
 
 
 	// emote
@@ -170,7 +292,8 @@ bool RoboBrrd::init() {
 	servosAttach();
 	servosHome();
 
-	ledsDefault();
+	// the eyes go back to the default once the light sensors are calibrated
+	if(!calibration_blink) ledsDefault();
 	robotgrrlSong();
 	
 	if(LOG_LEVEL <= DEBUG) Serial << "Completed initialisation!" << endl;
@@ -182,23 +305,24 @@ bool RoboBrrd::init() {
 
 void RoboBrrd::update() {
 
-	if(light_sensors_enabled) {
-		calibrateLightSensors();
-		isLeftLDRTriggered();
-		isRightLDRTriggered();
-	}
+	updateChoreo();
+	updateMotion();
+	updateTrajectories();
 
-	if(millis()-last_emote_save > 120000UL && emote_auto_save == true) {
+	if(light_sensors_enabled) calibrateLightSensors();
+
+	if(hal_millis()-last_emote_save > 120000UL && emote_auto_save == true) {
 		saveState();
 		saveMood();
-		last_emote_save = millis();
+		last_emote_save = hal_millis();
 	}
 
-	for(uint8_t i=0; i<4; i++) {
-		if(millis()-last_servos_moved[i] >= AUTO_DETACH_TIMER) {
-			servoDetach(i);
-		}
-	}
+	updateEyes();
+	ditherEyes();
+	updateMelody();
+	updateSpeaker();
+
+	updateServoPower();
 
 }
 
@@ -224,21 +348,21 @@ void RoboBrrd::initServos() {
 
 	if(LOG_LEVEL <= DEBUG) Serial << "Initialising the servos from eeprom";
 
-	rot_pos[0] = EEPROM.read(rot_addr[0]);
-	rot_pos[1] = EEPROM.read(rot_addr[1]);
-	rot_pos[2] = EEPROM.read(rot_addr[2]);
+	rot_pos[0] = hal_eepromRead(rot_addr[0]);
+	rot_pos[1] = hal_eepromRead(rot_addr[1]);
+	rot_pos[2] = hal_eepromRead(rot_addr[2]);
 
-	beak_pos[0] = EEPROM.read(beak_addr[0]);
-	beak_pos[1] = EEPROM.read(beak_addr[1]);
-	beak_pos[2] = EEPROM.read(beak_addr[2]);
+	beak_pos[0] = hal_eepromRead(beak_addr[0]);
+	beak_pos[1] = hal_eepromRead(beak_addr[1]);
+	beak_pos[2] = hal_eepromRead(beak_addr[2]);
 
-	rwing_pos[0] = EEPROM.read(rwing_addr[0]);
-	rwing_pos[1] = EEPROM.read(rwing_addr[1]);
-	rwing_pos[2] = EEPROM.read(rwing_addr[2]);
+	rwing_pos[0] = hal_eepromRead(rwing_addr[0]);
+	rwing_pos[1] = hal_eepromRead(rwing_addr[1]);
+	rwing_pos[2] = hal_eepromRead(rwing_addr[2]);
 
-	lwing_pos[0] = EEPROM.read(lwing_addr[0]);
-	lwing_pos[1] = EEPROM.read(lwing_addr[1]);
-	lwing_pos[2] = EEPROM.read(lwing_addr[2]);
+	lwing_pos[0] = hal_eepromRead(lwing_addr[0]);
+	lwing_pos[1] = hal_eepromRead(lwing_addr[1]);
+	lwing_pos[2] = hal_eepromRead(lwing_addr[2]);
 
 	if(LOG_LEVEL <= DEBUG) Serial << "......Done" << endl;
 
@@ -248,19 +372,19 @@ void RoboBrrd::setServoHome(uint8_t ser, uint16_t pos) {
 
 	switch(ser) {
 		case ROTATION_SERVO:
-			EEPROM.write(rot_addr[0], pos);
+			hal_eepromWrite(rot_addr[0], pos);
 			rot_pos[0] = pos;
 		break;
 		case BEAK_SERVO:
-			EEPROM.write(beak_addr[0], pos);
+			hal_eepromWrite(beak_addr[0], pos);
 			beak_pos[0] = pos;
 		break;
 		case RWING_SERVO:
-			EEPROM.write(rwing_addr[0], pos);
+			hal_eepromWrite(rwing_addr[0], pos);
 			rwing_pos[0] = pos;
 		break;
 		case LWING_SERVO:
-			EEPROM.write(lwing_addr[0], pos);
+			hal_eepromWrite(lwing_addr[0], pos);
 			lwing_pos[0] = pos;
 		break;
 	}
@@ -272,33 +396,33 @@ void RoboBrrd::setServoDefaults(uint8_t ser, uint16_t p1, uint16_t p2, uint16_t
 
 	switch(ser) {
 		case ROTATION_SERVO:
-			EEPROM.write(rot_addr[0], p1);
-			EEPROM.write(rot_addr[1], p2);
-			EEPROM.write(rot_addr[2], p3);
+			hal_eepromWrite(rot_addr[0], p1);
+			hal_eepromWrite(rot_addr[1], p2);
+			hal_eepromWrite(rot_addr[2], p3);
 			rot_pos[0] = p1;
 			rot_pos[1] = p2;
 			rot_pos[2] = p3;
 		break;
 		case BEAK_SERVO:
-			EEPROM.write(beak_addr[0], p1);
-			EEPROM.write(beak_addr[1], p2);
-			EEPROM.write(beak_addr[2], p3);
+			hal_eepromWrite(beak_addr[0], p1);
+			hal_eepromWrite(beak_addr[1], p2);
+			hal_eepromWrite(beak_addr[2], p3);
 			beak_pos[0] = p1;
 			beak_pos[1] = p2;
 			beak_pos[2] = p3;
 		break;
 		case RWING_SERVO:
-			EEPROM.write(rwing_addr[0], p1);
-			EEPROM.write(rwing_addr[1], p2);
-			EEPROM.write(rwing_addr[2], p3);
+			hal_eepromWrite(rwing_addr[0], p1);
+			hal_eepromWrite(rwing_addr[1], p2);
+			hal_eepromWrite(rwing_addr[2], p3);
 			rwing_pos[0] = p1;
 			rwing_pos[1] = p2;
 			rwing_pos[2] = p3;
 		break;
 		case LWING_SERVO:
-			EEPROM.write(lwing_addr[0], p1);
-			EEPROM.write(lwing_addr[1], p2);
-			EEPROM.write(lwing_addr[2], p3);
+			hal_eepromWrite(lwing_addr[0], p1);
+			hal_eepromWrite(lwing_addr[1], p2);
+			hal_eepromWrite(lwing_addr[2], p3);
 			lwing_pos[0] = p1;
 			lwing_pos[1] = p2;
 			lwing_pos[2] = p3;
@@ -312,19 +436,19 @@ void RoboBrrd::setServoDefaultP2(uint8_t ser, uint16_t pos) {
 
 	switch(ser) {
 		case ROTATION_SERVO:
-			EEPROM.write(rot_addr[1], pos);
+			hal_eepromWrite(rot_addr[1], pos);
 			rot_pos[1] = pos;
 		break;
 		case BEAK_SERVO:
-			EEPROM.write(beak_addr[1], pos);
+			hal_eepromWrite(beak_addr[1], pos);
 			beak_pos[1] = pos;
 		break;
 		case RWING_SERVO:
-			EEPROM.write(rwing_addr[1], pos);
+			hal_eepromWrite(rwing_addr[1], pos);
 			rwing_pos[1] = pos;
 		break;
 		case LWING_SERVO:
-			EEPROM.write(lwing_addr[1], pos);
+			hal_eepromWrite(lwing_addr[1], pos);
 			lwing_pos[1] = pos;
 		break;
 	}
@@ -336,19 +460,19 @@ void RoboBrrd::setServoDefaultP3(uint8_t ser, uint16_t pos) {
 
 	switch(ser) {
 		case ROTATION_SERVO:
-			EEPROM.write(rot_addr[2], pos);
+			hal_eepromWrite(rot_addr[2], pos);
 			rot_pos[2] = pos;
 		break;
 		case BEAK_SERVO:
-			EEPROM.write(beak_addr[2], pos);
+			hal_eepromWrite(beak_addr[2], pos);
 			beak_pos[2] = pos;
 		break;
 		case RWING_SERVO:
-			EEPROM.write(rwing_addr[2], pos);
+			hal_eepromWrite(rwing_addr[2], pos);
 			rwing_pos[2] = pos;
 		break;
 		case LWING_SERVO:
-			EEPROM.write(lwing_addr[2], pos);
+			hal_eepromWrite(lwing_addr[2], pos);
 			lwing_pos[2] = pos;
 		break;
 	}
@@ -358,24 +482,42 @@ void RoboBrrd::setServoDefaultP3(uint8_t ser, uint16_t pos) {
 
 void RoboBrrd::servosAttach() {
 
-	if(!servo[0].attached()) servo[0].attach(rotational_servo_pin);
-	if(!servo[1].attached()) servo[1].attach(beak_servo_pin);
-	if(!servo[2].attached()) servo[2].attach(rwing_servo_pin);
-	if(!servo[3].attached()) servo[3].attach(lwing_servo_pin);
+	for(uint8_t i=0; i<4; i++) {
+		servoAttach(i);
+	}
 
 }
 
 
 void RoboBrrd::servoAttach(uint8_t ser) {
 
-	if(ser == ROTATION_SERVO) {
-		if(!servo[0].attached()) servo[0].attach(rotational_servo_pin);
-	} else if(ser == BEAK_SERVO) {
-		if(!servo[1].attached()) servo[1].attach(beak_servo_pin);
-	} else if(ser == RWING_SERVO) {
-		if(!servo[2].attached()) servo[2].attach(rwing_servo_pin);
-	} else if(ser == LWING_SERVO) {
-		if(!servo[3].attached()) servo[3].attach(lwing_servo_pin);
+	uint8_t pin = 0;
+
+	switch(ser) {
+		case ROTATION_SERVO:
+			pin = rotational_servo_pin;
+		break;
+		case BEAK_SERVO:
+			pin = beak_servo_pin;
+		break;
+		case RWING_SERVO:
+			pin = rwing_servo_pin;
+		break;
+		case LWING_SERVO:
+			pin = lwing_servo_pin;
+		break;
+		default:
+		return;
+	}
+
+	if(!servo[ser].attached()) {
+		servo[ser].attach(pin);
+		servo_attaches[ser]++;
+	}
+
+	if(servo_power[ser] == SERVO_DETACHED) {
+		servo_power[ser] = SERVO_HOLDING;
+		last_servo_move[ser] = hal_millis();
 	}
 
 }
@@ -384,7 +526,7 @@ void RoboBrrd::servoAttach(uint8_t ser) {
 void RoboBrrd::servosDetach() {
 
 	for(uint8_t i=0; i<4; i++) {
-		if(servo[i].attached()) servo[i].detach();
+		servoDetach(i);
 	}
 
 }
@@ -392,19 +534,67 @@ void RoboBrrd::servosDetach() {
 
 void RoboBrrd::servoDetach(uint8_t ser) {
 
-	if(ser == ROTATION_SERVO) {
-		if(servo[0].attached()) servo[0].detach();
-	} else if(ser == BEAK_SERVO) {
-		if(servo[1].attached()) servo[1].detach();
-	} else if(ser == RWING_SERVO) {
-		if(servo[2].attached()) servo[2].detach();
-	} else if(ser == LWING_SERVO) {
-		if(servo[3].attached()) servo[3].detach();
+	if(ser > LWING_SERVO) return;
+
+	if(servo[ser].attached()) {
+		servo[ser].detach();
+		servo_detaches[ser]++;
+	}
+
+	servo_power[ser] = SERVO_DETACHED;
+
+}
+
+
+// called whenever a servo is given somewhere to go. it gets attached
+// again if it was resting.
+void RoboBrrd::servoWake(uint8_t ser) {
+
+	if(servo_power[ser] == SERVO_DETACHED) servoAttach(ser);
+
+	servo_power[ser] = SERVO_ACTIVE;
+	last_servo_move[ser] = hal_millis();
+
+}
+
+
+// active -> holding once the servo has reached its target, then
+// holding -> detached once it has been still for its hold time
+void RoboBrrd::updateServoPower() {
+
+	for(uint8_t i=0; i<4; i++) {
+
+		uint8_t bit = (1<<i);
+
+		switch(servo_power[i]) {
+
+			case SERVO_ACTIVE:
+				if((traj_active_mask & bit) || (traj_dirty_mask & bit)) {
+					last_servo_move[i] = hal_millis();
+				} else {
+					servo_power[i] = SERVO_HOLDING;
+				}
+			break;
+
+			case SERVO_HOLDING:
+				if(auto_detach && hal_millis()-last_servo_move[i] >= servo_hold_time[i]) {
+					servoDetach(i);
+				}
+			break;
+
+		}
+
 	}
 
 }
 
 
+void RoboBrrd::setServoHoldTime(uint8_t ser, uint16_t ms) {
+	if(ser > LWING_SERVO) return;
+	servo_hold_time[ser] = ms;
+}
+
+
 void RoboBrrd::servosHome() {
 
 	uint8_t del = 50;
@@ -419,889 +609,2562 @@ void RoboBrrd::servosHome() {
 
 void RoboBrrd::servoMove(uint8_t ser, uint8_t pos, uint16_t del) {
 
-	if(auto_detach) servoAttach(ser);
+	if(async_motion) {
+		enqueueWaypoint(ser, pos, del);
+		return;
+	}
 
-	servo[ser].write(pos);
-	delay(del);
+	// already sitting there (going by where the trajectory actually is, a
+	// stopped move might not have got to its target), so there is nothing
+	// to write. it still gets woken up if it was resting, and it still
+	// waits, sketches use the delay for timing
+	uint8_t bit = (1<<ser);
+	int32_t want = (int32_t)degToMicros(pos) << 8;
+
+	if((traj_known_mask & bit) && !(traj_active_mask & bit) && traj_pos[ser] == want && traj_target[ser] == want) {
+		servoWake(ser);
+		servo_writes_suppressed++;
+		waitMotion(del);
+		recordServoMove(ser, pos);
+		return;
+	}
 
-	if(auto_detach) servoDetach(ser);
+	setServoTarget(ser, pos);
+	waitMotion(del);
 
-	last_servo_move[ser] = millis();
-	last_servo_pos[ser] = pos;
+	recordServoMove(ser, pos);
 
-	for(uint8_t i=0; i<5; i++) {
-		last_servos_moved[i+1] = last_servos_moved[i];
-	}
+}
 
-	last_servos_moved[0] = ser;
 
+void RoboBrrd::recordServoMove(uint8_t ser, uint8_t pos) {
+	last_servo_pos[ser] = pos;
 }
 
 
 
-/*
- * Light Sensors
+/**
+ * Motion Scheduler
  */
 
-void RoboBrrd::initLightSensors() {
+bool RoboBrrd::enqueueWaypoint(uint8_t ser, uint8_t pos, uint16_t del) {
 
-	if(LOG_LEVEL <= DEBUG) *debug_stream << "Calibrating light sensors" << endl;
+	MotionCmd m;
+	m.gesture = NULL;
+	m.mask = (1<<ser);
+	m.pos[ser] = pos;
+	m.del = del;
 
-	bool blinky = false;
+	return enqueueMotion(&m);
 
-	while(!done_calibration) {
+}
 
-		calibrateLightSensors();
 
-		if(blinky) {
-			setEyesHSI(hue_blue, 0.0, 1.0);
-		} else {
-			setEyesHSI(hue_blue, 0.0, 0.8);
-		}
+// high priority moves cut off whatever is playing right now, and
+// are played before anything else that is waiting
+bool RoboBrrd::enqueueMotion(const MotionCmd *m, uint8_t priority) {
+
+	if(motion_count[priority] >= MOTION_QUEUE_SIZE) {
+		motion_overflows++;
+		if(LOG_LEVEL <= WARN) *debug_stream << "motion queue full, dropping move" << endl;
+		return false;
+	}
+
+	uint8_t tail = (motion_head[priority] + motion_count[priority]) % MOTION_QUEUE_SIZE;
 
-		blinky = !blinky;
-		delay(100);
+	motion_queue[priority][tail] = *m;
+	motion_count[priority]++;
 
+	if(priority == MOTION_HIGH && (motion_busy || gesture_ptr != NULL)) {
+		motion_busy = false;
+		gesture_ptr = NULL;
+		motion_preemptions++;
 	}
 
-	if(LOG_LEVEL <= DEBUG) Serial << "......Done" << endl;
+	return true;
 
 }
 
 
-void RoboBrrd::calibrateLightSensors() {
-
-	// check if it is time to calibrate or not
-	if(millis()-last_sampled < TIME_THRESH) return;
+uint8_t RoboBrrd::getMotionQueueDepth() {
 
-	// let's read the sensors now
-	previous_ldr_left_raw = current_ldr_left_raw;
-	previous_ldr_right_raw = current_ldr_right_raw;
+	uint8_t depth = 0;
+	for(uint8_t i=0; i<MOTION_PRIORITIES; i++) depth += motion_count[i];
 
-	current_ldr_left_raw = analogRead(ldr_left_pin);
-	current_ldr_right_raw = analogRead(ldr_right_pin);
+	return depth;
 
-	//if(LOG_LEVEL <= DEBUG) *debug_stream << "current raw L: " << current_ldr_left_raw << " R: "  << current_ldr_right_raw << " previous raw L: " << previous_ldr_left_raw << " R: " << previous_ldr_right_raw << endl; 
+}
 
 
-	// let's see what the change in the raw vals is. if the delta is not stable,
-	// we will not calibrate!
-	uint16_t raw_left_delta = 0;
-	uint16_t raw_right_delta = 0;
+void RoboBrrd::runMotion() {
 
-	if(previous_ldr_left_raw != current_ldr_left_raw) {
-		raw_left_delta = math_abs(previous_ldr_left_raw, current_ldr_left_raw);
+	while(isMoving()) {
+		updateMotion();
+		updateTrajectories();
 	}
 
-	if(raw_left_delta >= DELTA_THRESH) {
-		if(LOG_LEVEL <= DEBUG) *debug_stream << "too much delta in raw left val: " << raw_left_delta << endl; 
-		return;
-	}
+}
 
-	if(raw_right_delta >= DELTA_THRESH) {
-		if(LOG_LEVEL <= DEBUG) *debug_stream << "too much delta in raw right val: " << raw_right_delta << endl; 
-		return;
-	}
 
+void RoboBrrd::updateMotion() {
 
-	// capture the min and max vals
-	if(sample_count == 0) {
-		ldr_left_min_raw = current_ldr_left_raw;
-		ldr_left_max_raw = current_ldr_left_raw;
-		ldr_right_min_raw = current_ldr_right_raw;
-		ldr_right_max_raw = current_ldr_right_raw;
-	}
+	// still waiting for the current step to finish
+	if(motion_busy) {
 
+		if(hal_millis()-motion_step_start < motion_step_del) return;
 
-	// set any new min's and max's
-	if(current_ldr_left_raw < ldr_left_min_raw) ldr_left_min_raw = current_ldr_left_raw;
-	if(current_ldr_left_raw > ldr_right_max_raw) ldr_left_max_raw = current_ldr_left_raw;
-	if(current_ldr_right_raw < ldr_right_min_raw) ldr_right_min_raw = current_ldr_right_raw;
-	if(current_ldr_right_raw > ldr_right_max_raw) ldr_right_max_raw = current_ldr_right_raw;
+		motion_busy = false;
 
+		if(gesture_ptr == NULL && getMotionQueueDepth() == 0) {
+			if(motionComplete) motionComplete();
+			return;
+		}
 
-	// increment
-	ldr_left_total += current_ldr_left_raw;
-	ldr_right_total += current_ldr_right_raw;
-	sample_count++;
+	}
 
-	//if(LOG_LEVEL <= DEBUG) *debug_stream << "sample count: " << sample_count << endl;
-  
+	// start the next steps. ones with no delay are started in the
+	// same pass, that way a few servos can move together.
+	while(true) {
 
-  // now it is time to calculate the average val
-  if(sample_count >= SAMPLE_SIZE) {
+		uint8_t mask;
+		uint8_t pos[4];
+		uint16_t del;
 
+		if(gesture_ptr != NULL) {
 
-  	// calculate average
-  	previous_ldr_left_val = current_ldr_left_val;
-  	previous_ldr_right_val = current_ldr_left_val;
+			uint8_t ser;
 
-  	float temp1 = (float)( (float)(ldr_left_total) / SAMPLE_SIZE );
-  	current_ldr_left_val = (uint16_t)temp1;
+			if(!nextGestureStep(&ser, &pos[0], &del)) {
+				gesture_ptr = NULL;
+				continue;
+			}
 
-  	float temp2 = (float)( (float)(ldr_right_total) / SAMPLE_SIZE );
-  	current_ldr_right_val = (uint16_t)temp2;
+			mask = (1<<ser);
+			pos[ser] = pos[0];
 
+		} else if(getMotionQueueDepth() > 0) {
 
-  	// print it out
-  	if(LOG_LEVEL <= INFO) *debug_stream << "current val L: " << current_ldr_left_val << " R: " << current_ldr_right_val << endl; 
-    if(LOG_LEVEL <= INFO) *debug_stream << "L min: " << ldr_left_min_raw << " L max: " << ldr_left_max_raw << endl; 
-    if(LOG_LEVEL <= INFO) *debug_stream << "R min: " << ldr_right_min_raw << " R max: " << ldr_right_max_raw << endl; 
+			uint8_t pr = (motion_count[MOTION_HIGH] > 0) ? MOTION_HIGH : MOTION_NORMAL;
 
+			MotionCmd *m = &motion_queue[pr][motion_head[pr]];
+			motion_head[pr] = (motion_head[pr] + 1) % MOTION_QUEUE_SIZE;
+			motion_count[pr]--;
 
-    // reset!
-		ldr_left_total = 0;
-		ldr_right_total = 0;
-		sample_count = 0;
+			if(m->gesture != NULL) {
+				gesture_ptr = m->gesture;
+				gesture_pc = 0;
+				gesture_looping = false;
+				continue;
+			}
 
-		// calculate the new threshold values
-		left_bright_thresh = previous_ldr_left_val + BRIGHT_THRESH;
-		right_bright_thresh = previous_ldr_right_val + BRIGHT_THRESH;
-		left_dark_thresh = previous_ldr_left_val - DARK_THRESH;
-		right_dark_thresh = previous_ldr_right_val - DARK_THRESH;
-		
-		// let's hope these will save us some day
-		if( (int)previous_ldr_left_val + (int)BRIGHT_THRESH > 1023 ) left_bright_thresh = 1023;
-		if( (int)previous_ldr_right_val + (int)BRIGHT_THRESH > 1023 ) right_bright_thresh = 1023;
-		
-		if( (int)previous_ldr_left_val - (int)DARK_THRESH < 0 ) left_dark_thresh = 0;
-		if( (int)previous_ldr_right_val - (int)DARK_THRESH < 0 ) right_dark_thresh = 0;
+			mask = m->mask;
+			for(uint8_t i=0; i<4; i++) pos[i] = m->pos[i];
+			del = m->del;
 
-		// done for now!
-		done_calibration = true;
+		} else {
+			return;
+		}
 
-  }
+		for(uint8_t i=0; i<4; i++) {
 
-	last_sampled = millis();
+			if(!(mask & (1<<i))) continue;
 
-}
+			if(mask & KEYFRAME_TIMED) {
+				setServoTargetTimed(i, pos[i], del);
+			} else {
+				setServoTarget(i, pos[i]);
+			}
 
+			recordServoMove(i, pos[i]);
 
-// ldr states: 0 = normal, 1 = dark, 2 = bright
+		}
 
-uint8_t RoboBrrd::isLeftLDRTriggered() {
+		motion_step_start = hal_millis();
+		motion_step_del = del;
+		motion_busy = true;
 
-	uint8_t state = 0;
+		if(del > 0) return;
 
-	if(current_ldr_left_val < left_dark_thresh) {
-		state = 1;
-	} else if(current_ldr_left_val > left_bright_thresh) {
-		state = 2;
-	} else {
-		state = 0;
 	}
 
+}
 
-	if(state == 1) {
-
-		if(LOG_LEVEL <= DEBUG) *debug_stream << "dark! (L) " << current_ldr_left_val << " < " << left_dark_thresh << endl;
 
-		if(ldrLeftDark) ldrLeftDark();
+bool RoboBrrd::isMoving() {
+	return (motion_busy || getMotionQueueDepth() > 0 || gesture_ptr != NULL || traj_active_mask != 0);
+}
 
-	}
 
+void RoboBrrd::stopMotion() {
 
-	if(state == 2) {
+	for(uint8_t i=0; i<MOTION_PRIORITIES; i++) motion_count[i] = 0;
+	motion_busy = false;
+	gesture_ptr = NULL;
 
-		if(LOG_LEVEL <= DEBUG) *debug_stream << "bright! (L) " << current_ldr_left_val << " > " << left_bright_thresh << endl;
+	// hold the servos wherever they are right now
+	for(uint8_t i=0; i<4; i++) {
+		traj_target[i] = traj_pos[i];
+		traj_vel[i] = 0;
+	}
+	traj_active_mask = 0;
+	traj_timed_mask = 0;
 
-		if(ldrLeftBright) ldrLeftBright();
+}
 
-	}
 
 
-	return state;
+/**
+ * Gestures
+ */
 
-	/*
-	// this is just some old code that might be useful, if you ever want to 
-	// have the light and dark readings less sensitive.
+// each gesture is a list of steps that the scheduler plays back,
+// see the GESTURE_MOVE macros in RoboBrrd.h for the format.
 
-	// reset the counter if this is the first trigger in quite some time
-	if(millis()-last_left_trigger >= LDR_LAST_RESET && last_left_trigger != 0) {
-		trigger_left_sample = 0;
-	}
+#define ROT RoboBrrd::ROTATION_SERVO
+#define BEAK RoboBrrd::BEAK_SERVO
+#define RWING RoboBrrd::RWING_SERVO
+#define LWING RoboBrrd::LWING_SERVO
 
-	// increment and record the trigger...
-	trigger_left_sample++;
-	last_left_trigger = millis();
 
-	// if we exceed the specific number of threshold changes, then set the new state!
-	if(trigger_left_sample > CHANGE_THRESH) {
+// -- beak
 
-		trigger_left_sample = 0;
+static const uint8_t gesture_beak_open[] PROGMEM = {
+	GESTURE_MOVE(BEAK, GESTURE_P2, 0, 100),
+	GESTURE_END
+};
 
-		ldr_left_state = 1;
-		return ldr_left_state;
+static const uint8_t gesture_beak_close[] PROGMEM = {
+	GESTURE_MOVE(BEAK, GESTURE_P3, 0, 100),
+	GESTURE_END
+};
 
-	}
-	*/
+static const uint8_t gesture_beak_home[] PROGMEM = {
+	GESTURE_MOVE(BEAK, GESTURE_HOME, 0, 100),
+	GESTURE_END
+};
 
-}
+static const uint8_t gesture_beak_snip[] PROGMEM = {
+	GESTURE_MOVE(BEAK, GESTURE_P2, 0, 100),
+	GESTURE_MOVE(BEAK, GESTURE_P3, 0, 100),
+	GESTURE_REPEAT(2, 1),
+	GESTURE_END
+};
 
+static const uint8_t gesture_beak_laugh[] PROGMEM = {
+	GESTURE_MOVE(BEAK, GESTURE_P2, 0, 100),
+	GESTURE_MOVE(BEAK, GESTURE_P3, 0, 50),
+	GESTURE_REPEAT(2, 2),
+	GESTURE_END
+};
 
-uint8_t RoboBrrd::isRightLDRTriggered() {
 
-	uint8_t state = 0;
+// -- rotation
 
-	if(current_ldr_right_val < right_dark_thresh) {
-		state = 1;
-	} else if(current_ldr_right_val > right_bright_thresh) {
-		state = 2;
-	} else {
-		state = 0;
-	}
+static const uint8_t gesture_rotate_left[] PROGMEM = {
+	GESTURE_MOVE(ROT, GESTURE_P2, 0, 200),
+	GESTURE_END
+};
+
+static const uint8_t gesture_rotate_right[] PROGMEM = {
+	GESTURE_MOVE(ROT, GESTURE_P3, 0, 200),
+	GESTURE_END
+};
+
+static const uint8_t gesture_rotate_home[] PROGMEM = {
+	GESTURE_MOVE(ROT, GESTURE_HOME, 0, 150),
+	GESTURE_END
+};
+
+static const uint8_t gesture_shake_shake[] PROGMEM = {
+	GESTURE_MOVE(ROT, GESTURE_P2, 0, 300),
+	GESTURE_MOVE(ROT, GESTURE_P3, 0, 300),
+	GESTURE_REPEAT(2, 3),
+	GESTURE_MOVE(ROT, GESTURE_HOME, 0, 150),
+	GESTURE_END
+};
+
+static const uint8_t gesture_rotate_bounce[] PROGMEM = {
+	GESTURE_MOVE(ROT, GESTURE_P2, 0, 300),
+	GESTURE_MOVE(ROT, GESTURE_P2, 20, 50),
+	GESTURE_MOVE(ROT, GESTURE_P2, 0, 50),
+	GESTURE_REPEAT(2, 2),
+	GESTURE_MOVE(ROT, GESTURE_P3, 0, 300),
+	GESTURE_MOVE(ROT, GESTURE_P3, 20, 50),
+	GESTURE_MOVE(ROT, GESTURE_P3, 0, 50),
+	GESTURE_REPEAT(2, 2),
+	GESTURE_MOVE(ROT, GESTURE_HOME, 0, 150),
+	GESTURE_END
+};
 
 
-	if(state == 1) {
+// -- right wing
 
-		if(LOG_LEVEL <= DEBUG) *debug_stream << "dark! (L) " << current_ldr_right_val << " < " << right_dark_thresh << endl;
+static const uint8_t gesture_rwing_up[] PROGMEM = {
+	GESTURE_MOVE(RWING, GESTURE_P2, 0, 100),
+	GESTURE_END
+};
+
+static const uint8_t gesture_rwing_down[] PROGMEM = {
+	GESTURE_MOVE(RWING, GESTURE_P3, 0, 100),
+	GESTURE_END
+};
+
+static const uint8_t gesture_rwing_home[] PROGMEM = {
+	GESTURE_MOVE(RWING, GESTURE_HOME, 0, 100),
+	GESTURE_END
+};
+
+static const uint8_t gesture_rwing_wave[] PROGMEM = {
+	GESTURE_MOVE(RWING, GESTURE_P2, 0, 150),
+	GESTURE_MOVE(RWING, GESTURE_P3, 0, 150),
+	GESTURE_REPEAT(2, 2),
+	GESTURE_MOVE(RWING, GESTURE_HOME, 0, 80),
+	GESTURE_END
+};
+
+static const uint8_t gesture_rwing_gust[] PROGMEM = {
+	GESTURE_MOVE(RWING, GESTURE_P3, 0, 50),
+	GESTURE_MOVE(RWING, GESTURE_P3, 20, 50),
+	GESTURE_REPEAT(2, 2),
+	GESTURE_MOVE(RWING, GESTURE_HOME, 0, 80),
+	GESTURE_END
+};
 
-		if(ldrRightDark) ldrRightDark();
 
-	}
+// -- left wing
 
+static const uint8_t gesture_lwing_up[] PROGMEM = {
+	GESTURE_MOVE(LWING, GESTURE_P2, 0, 50),
+	GESTURE_END
+};
+
+static const uint8_t gesture_lwing_down[] PROGMEM = {
+	GESTURE_MOVE(LWING, GESTURE_P3, 0, 50),
+	GESTURE_END
+};
+
+static const uint8_t gesture_lwing_home[] PROGMEM = {
+	GESTURE_MOVE(LWING, GESTURE_HOME, 0, 50),
+	GESTURE_END
+};
+
+static const uint8_t gesture_lwing_wave[] PROGMEM = {
+	GESTURE_MOVE(LWING, GESTURE_P2, 0, 150),
+	GESTURE_MOVE(LWING, GESTURE_P3, 0, 150),
+	GESTURE_REPEAT(2, 2),
+	GESTURE_MOVE(LWING, GESTURE_HOME, 0, 80),
+	GESTURE_END
+};
+
+static const uint8_t gesture_lwing_gust[] PROGMEM = {
+	GESTURE_MOVE(LWING, GESTURE_P3, 0, 50),
+	GESTURE_MOVE(LWING, GESTURE_P3, 20, 50),
+	GESTURE_REPEAT(2, 2),
+	GESTURE_MOVE(LWING, GESTURE_HOME, 0, 80),
+	GESTURE_END
+};
+
+
+// -- wings (a step with no time starts together with the next one)
+
+static const uint8_t gesture_wings_up[] PROGMEM = {
+	GESTURE_MOVE(RWING, GESTURE_P2, 0, 0),
+	GESTURE_MOVE(LWING, GESTURE_P2, 0, 150),
+	GESTURE_END
+};
+
+static const uint8_t gesture_wings_down[] PROGMEM = {
+	GESTURE_MOVE(RWING, GESTURE_P3, 0, 0),
+	GESTURE_MOVE(LWING, GESTURE_P3, 0, 150),
+	GESTURE_END
+};
+
+static const uint8_t gesture_wings_wave[] PROGMEM = {
+	GESTURE_MOVE(RWING, GESTURE_P2, 0, 0),
+	GESTURE_MOVE(LWING, GESTURE_P2, 0, 150),
+	GESTURE_MOVE(RWING, GESTURE_P3, 0, 0),
+	GESTURE_MOVE(LWING, GESTURE_P3, 0, 150),
+	GESTURE_REPEAT(4, 3),
+	GESTURE_MOVE(RWING, GESTURE_HOME, 0, 0),
+	GESTURE_MOVE(LWING, GESTURE_HOME, 0, 80),
+	GESTURE_END
+};
+
+static const uint8_t gesture_wings_wave_opposite[] PROGMEM = {
+	GESTURE_MOVE(RWING, GESTURE_P2, 0, 0),
+	GESTURE_MOVE(LWING, GESTURE_P3, 0, 150),
+	GESTURE_MOVE(RWING, GESTURE_P3, 0, 0),
+	GESTURE_MOVE(LWING, GESTURE_P2, 0, 150),
+	GESTURE_REPEAT(4, 3),
+	GESTURE_MOVE(RWING, GESTURE_HOME, 0, 0),
+	GESTURE_MOVE(LWING, GESTURE_HOME, 0, 80),
+	GESTURE_END
+};
+
+static const uint8_t gesture_wings_gust[] PROGMEM = {
+	GESTURE_MOVE(LWING, GESTURE_P3, 0, 0),
+	GESTURE_MOVE(RWING, GESTURE_P3, 0, 50),
+	GESTURE_MOVE(LWING, GESTURE_P3, 20, 0),
+	GESTURE_MOVE(RWING, GESTURE_P3, 20, 50),
+	GESTURE_REPEAT(4, 2),
+	GESTURE_MOVE(RWING, GESTURE_HOME, 0, 0),
+	GESTURE_MOVE(LWING, GESTURE_HOME, 0, 80),
+	GESTURE_END
+};
+
+static const uint8_t gesture_wings_gust_opposite[] PROGMEM = {
+	GESTURE_MOVE(LWING, GESTURE_P3, 0, 0),
+	GESTURE_MOVE(RWING, GESTURE_P3, 20, 50),
+	GESTURE_MOVE(LWING, GESTURE_P3, 20, 0),
+	GESTURE_MOVE(RWING, GESTURE_P3, 0, 50),
+	GESTURE_REPEAT(4, 2),
+	GESTURE_MOVE(RWING, GESTURE_HOME, 0, 0),
+	GESTURE_MOVE(LWING, GESTURE_HOME, 0, 80),
+	GESTURE_END
+};
+
+#undef ROT
+#undef BEAK
+#undef RWING
+#undef LWING
+
+
+// in the same order as the Gesture enum
+static const uint8_t * const gesture_tables[] PROGMEM = {
+	gesture_beak_open,
+	gesture_beak_close,
+	gesture_beak_home,
+	gesture_beak_snip,
+	gesture_beak_laugh,
+	gesture_rotate_left,
+	gesture_rotate_right,
+	gesture_rotate_home,
+	gesture_shake_shake,
+	gesture_rotate_bounce,
+	gesture_rwing_up,
+	gesture_rwing_down,
+	gesture_rwing_home,
+	gesture_rwing_wave,
+	gesture_rwing_gust,
+	gesture_lwing_up,
+	gesture_lwing_down,
+	gesture_lwing_home,
+	gesture_lwing_wave,
+	gesture_lwing_gust,
+	gesture_wings_up,
+	gesture_wings_down,
+	gesture_wings_wave,
+	gesture_wings_wave_opposite,
+	gesture_wings_gust,
+	gesture_wings_gust_opposite
+};
+
+
+bool RoboBrrd::enqueueGesture(uint8_t id, uint8_t priority) {
 
-	if(state == 2) {
+	if(id >= NUM_GESTURES) return false;
 
-		if(LOG_LEVEL <= DEBUG) *debug_stream << "bright! (L) " << current_ldr_right_val << " > " << right_bright_thresh << endl;
+	MotionCmd m;
+	m.gesture = (const uint8_t *)pgm_read_ptr(&gesture_tables[id]);
+	m.mask = 0;
+	m.del = 0;
+
+	return enqueueMotion(&m, priority);
+
+}
+
+
+void RoboBrrd::playGesture(uint8_t id) {
+
+	if(!enqueueGesture(id, MOTION_NORMAL)) return;
 
-		if(ldrRightBright) ldrRightBright();
+	// not async, so play it through the scheduler right here
+	if(!async_motion) runMotion();
+
+}
 
-	}
 
+void RoboBrrd::playGestureTable(const uint8_t *gesture) {
 
-	return state;
+	MotionCmd m;
+	m.gesture = gesture;
+	m.mask = 0;
+	m.del = 0;
 
-}
+	if(!enqueueMotion(&m)) return;
 
+	// not async, so play it through the scheduler right here
+	if(!async_motion) runMotion();
 
-uint16_t RoboBrrd::math_abs(uint16_t a, uint16_t b) {
-  
-  // for some reason the abs() function is giving us a negative number,
-  // even though we are not passing a function to the macro. weird behaviour.
-  // it is seemingly because it is not ordering the numbers properly.
-  
-  if(a > b) return abs(a-b);
-  
-  if(b > a) return abs(b-a);
-  
 }
 
 
 
-
 /**
- * Emote
+ * Choreography
  */
 
-void RoboBrrd::saveMood() {
-	EEPROM.write(mood_addr[0], emote_happy);
-	EEPROM.write(mood_addr[1], emote_chill);
-}
-
-void RoboBrrd::saveState() {
-	EEPROM.write(state_addr[0], emote_food);
-	EEPROM.write(state_addr[1], emote_water);
-	EEPROM.write(state_addr[2], emote_play);
-}
+// a choreography is streamed in chunks into two buffers. one of them
+// plays while the other one is being filled, and every time a buffer
+// frees up we tell the other side how many are free (#C3,<free>!), so
+// that it can send the next chunk before we run out.
 
-void RoboBrrd::setMood(uint8_t happy, uint8_t chill) {
-	emote_happy = happy;
-	emote_chill = chill;
-}
+void RoboBrrd::startChoreo() {
 
-void RoboBrrd::setState(uint8_t food, uint8_t water, uint8_t play) {
-	emote_food = food;
-	emote_water = water;
-	emote_play = play;
-}
+	choreo_playing = true;
+	choreo_starving = false;
+	choreo_wait = 0;
 
-void RoboBrrd::initEmotes() {
+	sendChoreoFree();
 
-	if(LOG_LEVEL <= DEBUG) Serial << "Starting emotes";
+}
 
-	emote_happy = EEPROM.read(mood_addr[0]);
-	emote_chill = EEPROM.read(mood_addr[1]);
 
-	emote_food = EEPROM.read(state_addr[0]);
-	emote_water = EEPROM.read(state_addr[1]);
-	emote_play = EEPROM.read(state_addr[2]);
+void RoboBrrd::stopChoreo() {
 
-	setEmotePlay(emote_play+20); // here's a treat for being initialised, yum yum
+	choreo_playing = false;
 
-	if(LOG_LEVEL <= DEBUG) Serial << "......Done" << endl;
+	for(uint8_t i=0; i<2; i++) {
+		choreo_len[i] = 0;
+		choreo_ready[i] = false;
+	}
+	choreo_play_buf = 0;
+	choreo_fill_buf = 0;
+	choreo_pos = 0;
 
 }
 
 
+bool RoboBrrd::addChoreoStep(uint8_t move, uint16_t wait) {
 
+	uint8_t b = choreo_fill_buf;
 
-/*
- * LED Eyes Functions
- */
-
-void RoboBrrd::ledsDefault() {
-	uint8_t def_red = EEPROM.read(led_addr[0]);
-	uint8_t def_green = EEPROM.read(led_addr[1]);
-	uint8_t def_blue = EEPROM.read(led_addr[2]);
+	if(choreo_ready[b] || choreo_len[b] >= CHOREO_CHUNK_SIZE || move >= NUM_GESTURES) {
+		choreo_dropped++;
+		if(LOG_LEVEL <= WARN) *debug_stream << "choreo buffer full, dropping step" << endl;
+		return false;
+	}
 
-	setEyesRGB(def_red, def_green, def_blue);
-}
+	choreo_buf[b][choreo_len[b]].move = move;
+	choreo_buf[b][choreo_len[b]].wait = wait;
+	choreo_len[b]++;
 
+	return true;
 
-void RoboBrrd::saveLedsDefault() {
-	EEPROM.write(led_addr[0], current_rgb[0]);
-	EEPROM.write(led_addr[1], current_rgb[1]);
-	EEPROM.write(led_addr[2], current_rgb[2]);
 }
 
 
-void RoboBrrd::setEyesRGB(uint8_t r, uint8_t g, uint8_t b) {
-  
-	double hsv[3];
-
-	rgb2hsv(r, g, b, hsv);
+void RoboBrrd::commitChoreoChunk() {
 
-  current_rgb[0] = r;
-  current_rgb[1] = g;
-  current_rgb[2] = b;
-  current_hsi[0] = (float)hsv[0];
-  current_hsi[1] = (float)hsv[1];
-  current_hsi[2] = (float)hsv[2];
-  
-  analogWrite(led_pins[0], r * MAX_BRIGHTNESS);
-  analogWrite(led_pins[1], g * MAX_BRIGHTNESS);
-  analogWrite(led_pins[2], b * MAX_BRIGHTNESS);
-  
-}
+	uint8_t b = choreo_fill_buf;
 
+	if(choreo_ready[b] || choreo_len[b] == 0) return;
 
-void RoboBrrd::setEyesHSI(float h, float s, float i) {
-  
-  int rgb[3];
-  
-  hsi2rgb(h, s, i, rgb);
-  
-  
-  uint8_t new_r = (uint8_t)(rgb[0] * MAX_BRIGHTNESS); 
-  uint8_t new_g = (uint8_t)(rgb[1] * MAX_BRIGHTNESS);
-  uint8_t new_b = (uint8_t)(rgb[2] * MAX_BRIGHTNESS);
-  
-  current_rgb[0] = new_r;
-  current_rgb[1] = new_g;
-  current_rgb[2] = new_b;
-  current_hsi[0] = h;
-  current_hsi[1] = s;
-  current_hsi[2] = i;
-  
-  analogWrite(led_pins[0], new_r);
-  analogWrite(led_pins[1], new_g);
-  analogWrite(led_pins[2], new_b);
-  
-}
+	choreo_ready[b] = true;
+	choreo_fill_buf = !b;
 
+	sendChoreoFree();
 
-// This function is by Brian Neltner from Saikoled
-// http://blog.saikoled.com/post/43693602826/why-every-led-light-should-be-using-hsi-colorspace
-void RoboBrrd::hsi2rgb(float H, float S, float I, int *rgb) {
-  
-  int r, g, b;
-  H = fmod(H,360); // cycle H around to 0-360 degrees
-  H = 3.14159*H/(float)180; // Convert to radians.
-  S = S>0?(S<1?S:1):0; // clamp S and I to interval [0,1]
-  I = I>0?(I<1?I:1):0;
-    
-  // Math! Thanks in part to Kyle Miller.
-  if(H < 2.09439) {
-    r = 255*I/3*(1+S*cos(H)/cos(1.047196667-H));
-    g = 255*I/3*(1+S*(1-cos(H)/cos(1.047196667-H)));
-    b = 255*I/3*(1-S);
-  } else if(H < 4.188787) {
-    H = H - 2.09439;
-    g = 255*I/3*(1+S*cos(H)/cos(1.047196667-H));
-    b = 255*I/3*(1+S*(1-cos(H)/cos(1.047196667-H)));
-    r = 255*I/3*(1-S);
-  } else {
-    H = H - 4.188787;
-    b = 255*I/3*(1+S*cos(H)/cos(1.047196667-H));
-    r = 255*I/3*(1+S*(1-cos(H)/cos(1.047196667-H)));
-    g = 255*I/3*(1-S);
-  }
-  
-  rgb[0]=r;
-  rgb[1]=g;
-  rgb[2]=b;
-  
 }
 
 
-// This function is by Robert Atkins
-// https://github.com/ratkins/RGBConverter
-void RoboBrrd::rgb2hsv(uint8_t r, uint8_t g, uint8_t b, double *hsv) {
-    double rd = (double) r/255;
-    double gd = (double) g/255;
-    double bd = (double) b/255;
-    double max = threeway_max(rd, gd, bd), min = threeway_min(rd, gd, bd);
-    double h, s, v = max;
+void RoboBrrd::sendChoreoFree() {
 
-    double d = max - min;
-    s = max == 0 ? 0 : d / max;
+	uint8_t free_bufs = 0;
+	for(uint8_t i=0; i<2; i++) {
+		if(!choreo_ready[i]) free_bufs++;
+	}
 
-    if (max == min) { 
-        h = 0; // achromatic
-    } else {
-        if (max == rd) {
-            h = (gd - bd) / d + (gd < bd ? 6 : 0);
-        } else if (max == gd) {
-            h = (bd - rd) / d + 2;
-        } else if (max == bd) {
-            h = (rd - gd) / d + 4;
-        }
-        h /= 6;
-    }
+	transmit_message(choreo_stream, '#', 'C', 3, free_bufs, '!');
 
-    hsv[0] = h;
-    hsv[1] = s;
-    hsv[2] = v;
 }
 
 
-double RoboBrrd::threeway_max(double a, double b, double c) {
-    return max(a, max(b, c));
-}
+void RoboBrrd::updateChoreo() {
 
+	if(!choreo_playing) return;
+	if(hal_millis()-choreo_last_step < choreo_wait) return;
 
-double RoboBrrd::threeway_min(double a, double b, double c) {
-    return min(a, min(b, c));
-}
+	uint8_t b = choreo_play_buf;
 
+	// finished this chunk, hand the buffer back and move to the other one
+	if(choreo_ready[b] && choreo_pos >= choreo_len[b]) {
+		choreo_ready[b] = false;
+		choreo_len[b] = 0;
+		choreo_pos = 0;
+		choreo_play_buf = !b;
+		b = choreo_play_buf;
+		sendChoreoFree();
+	}
 
+	if(!choreo_ready[b]) {
+		if(!choreo_starving) {
+			choreo_starved++;
+			choreo_starving = true;
+		}
+		return;
+	}
 
+	choreo_starving = false;
 
-/**
- * Speaker
- */
+	ChoreoStep *step = &choreo_buf[b][choreo_pos];
+	choreo_pos++;
 
-void RoboBrrd::robotgrrlSong() {
-  for(uint8_t i=0; i<5; i++) {
-    playTone(260, 70);
-    playTone(280, 70);
-    playTone(300, 70);
-    delay(100);
-  } 
-}
+	enqueueGesture(step->move, MOTION_NORMAL);
 
+	choreo_last_step = hal_millis();
+	choreo_wait = step->wait;
 
-void RoboBrrd::playTone(uint16_t tone, uint16_t duration) {
-	
-  for (long i = 0; i < duration * 1000L; i += tone * 2) {
-    digitalWrite(spkr_pin, HIGH);
-    delayMicroseconds(tone);
-    digitalWrite(spkr_pin, LOW);
-    delayMicroseconds(tone);
-  }
-	
 }
 
 
 
 /**
- * Movements
+ * Keyframes
  */
 
+void RoboBrrd::keyframe(uint8_t mask, uint8_t rot, uint8_t beak, uint8_t rwing, uint8_t lwing, uint16_t duration) {
 
-// -- beak
+	MotionCmd m;
+	m.gesture = NULL;
+	m.mask = (mask & 0x0F) | KEYFRAME_TIMED;
+	m.pos[ROTATION_SERVO] = rot;
+	m.pos[BEAK_SERVO] = beak;
+	m.pos[RWING_SERVO] = rwing;
+	m.pos[LWING_SERVO] = lwing;
+	m.del = duration;
 
-void RoboBrrd::beakOpen() {
-	servoMove(BEAK_SERVO, beak_pos[1], 100);
-}
+	if(!enqueueMotion(&m)) return;
 
-void RoboBrrd::beakClose() {
-	servoMove(BEAK_SERVO, beak_pos[2], 100);
-}
+	if(!async_motion) runMotion();
 
-void RoboBrrd::beakHome() {
-	servoMove(BEAK_SERVO, beak_pos[0], 100);
 }
 
-void RoboBrrd::beakSnip() {
 
-	for(uint8_t i=0; i<2; i++) {
-		servoMove(BEAK_SERVO, beak_pos[1], 100);
-		servoMove(BEAK_SERVO, beak_pos[2], 100);
-	}
+uint8_t RoboBrrd::gestureTarget(uint8_t ser, uint8_t target, uint8_t offset) {
 
-}
+	uint8_t *p = rot_pos;
 
-void RoboBrrd::beakLaugh() {
+	switch(ser) {
+		case BEAK_SERVO:
+			p = beak_pos;
+		break;
+		case RWING_SERVO:
+			p = rwing_pos;
+		break;
+		case LWING_SERVO:
+			p = lwing_pos;
+		break;
+	}
 
-	for(uint8_t i=0; i<3; i++) {
-		servoMove(BEAK_SERVO, beak_pos[1], 100);
-		servoMove(BEAK_SERVO, beak_pos[2], 50);
+	uint8_t pos = p[target];
+
+	// offsets always go back towards home
+	if(target != GESTURE_HOME && offset > 0) {
+		if(pos < p[GESTURE_HOME]) {
+			pos += offset;
+		} else {
+			pos -= offset;
+		}
 	}
-	
-}
 
-void RoboBrrd::beakPos(uint8_t pos) {
-	servoMove(BEAK_SERVO, pos, 100);
+	return pos;
+
 }
 
 
+// fetches the next move from the running gesture. returns false
+// when the gesture has ended.
+bool RoboBrrd::nextGestureStep(uint8_t *ser, uint8_t *pos, uint16_t *del) {
 
-// -- rotation
+	while(true) {
+
+		const uint8_t *step = gesture_ptr + (gesture_pc * 3);
+		uint8_t op = pgm_read_byte(step);
+		uint8_t arg = pgm_read_byte(step+1);
+		uint8_t t = pgm_read_byte(step+2);
+
+		if(op == GESTURE_OP_END) return false;
+
+		if(op == GESTURE_OP_REPEAT) {
+
+			if(!gesture_looping) {
+				gesture_looping = true;
+				gesture_loops_left = t;
+			}
+
+			if(gesture_loops_left > 0) {
+				gesture_loops_left--;
+				gesture_pc -= arg;
+			} else {
+				gesture_looping = false;
+				gesture_pc++;
+			}
+
+			continue;
+
+		}
+
+		*ser = op & 0x03;
+		*pos = gestureTarget(*ser, (op >> 4) & 0x03, arg);
+		*del = (uint16_t)t * 10;
+		gesture_pc++;
+
+		return true;
+
+	}
+
+}
+
+
+
+/**
+ * Trajectories
+ */
+
+void RoboBrrd::setServoSpeed(uint8_t ser, uint16_t max_speed, uint16_t max_accel) {
+
+	if(ser > LWING_SERVO) return;
+
+	if(max_speed == 0 || max_accel == 0) {
+		traj_max_vel[ser] = 0;
+		traj_accel[ser] = 0;
+		return;
+	}
+
+	// deg/s to us/tick, then into 8 fractional bits
+	uint32_t us_per_s = ((uint32_t)max_speed * (SERVO_MAX_US-SERVO_MIN_US)) / 180;
+	uint32_t v = (us_per_s * TRAJ_TICK * 256) / 1000;
+	if(v > 0xFFFF) v = 0xFFFF;
+	if(v == 0) v = 1;
+
+	// deg/s^2 to us/tick^2, split up so that it doesn't overflow
+	uint32_t us_per_s2 = ((uint32_t)max_accel * (SERVO_MAX_US-SERVO_MIN_US)) / 180;
+	uint32_t a = (((us_per_s2 * 256) / 1000) * TRAJ_TICK * TRAJ_TICK) / 1000;
+	if(a > 0xFFFF) a = 0xFFFF;
+	if(a == 0) a = 1;
+
+	traj_max_vel[ser] = (uint16_t)v;
+	traj_accel[ser] = (uint16_t)a;
+
+}
+
+
+uint16_t RoboBrrd::degToMicros(uint8_t pos) {
+	if(pos > 180) pos = 180;
+	return SERVO_MIN_US + (uint16_t)(((uint32_t)pos * (SERVO_MAX_US-SERVO_MIN_US)) / 180);
+}
+
+
+// writes are held until the next tick, so that a few targets for the
+// same servo in one tick only go out once, and ones that don't change
+// the pulse width are dropped
+void RoboBrrd::flushServos() {
+
+	for(uint8_t i=0; i<4; i++) {
+
+		if(!(traj_dirty_mask & (1<<i))) continue;
+
+		uint16_t us = (uint16_t)((traj_pos[i] + 128) >> 8);
+
+		if(us == traj_out[i]) {
+			servo_writes_suppressed++;
+		} else {
+			servo[i].writeMicroseconds(us);
+			traj_out[i] = us;
+			servo_writes++;
+		}
+
+	}
+
+	traj_dirty_mask = 0;
+
+}
+
+
+void RoboBrrd::jumpServo(uint8_t ser, uint16_t us) {
+
+	uint8_t bit = (1<<ser);
+
+	traj_pos[ser] = (int32_t)us << 8;
+	traj_target[ser] = traj_pos[ser];
+	traj_vel[ser] = 0;
+	traj_active_mask &= ~bit;
+	traj_timed_mask &= ~bit;
+	traj_known_mask |= bit;
+
+	// a write from earlier in this tick that never went out
+	if(traj_dirty_mask & bit) servo_writes_suppressed++;
+	traj_dirty_mask |= bit;
+
+}
+
+
+void RoboBrrd::setServoTarget(uint8_t ser, uint8_t pos) {
+
+	uint16_t us = degToMicros(pos);
+	uint8_t bit = (1<<ser);
+
+	servoWake(ser);
+
+	// no limits (or we don't know where it is yet), so jump right there
+	if(traj_max_vel[ser] == 0 || !(traj_known_mask & bit)) {
+		jumpServo(ser, us);
+		return;
+	}
+
+	traj_timed_mask &= ~bit;
+	traj_target[ser] = (int32_t)us << 8;
+
+	if(traj_target[ser] != traj_pos[ser] || traj_vel[ser] != 0) {
+		if(traj_active_mask == 0) last_traj_tick = hal_millis()-TRAJ_TICK;
+		traj_active_mask |= bit;
+	}
+
+}
+
+
+// moves at a constant speed so that it arrives after duration ms. servos
+// given the same duration all arrive together.
+void RoboBrrd::setServoTargetTimed(uint8_t ser, uint8_t pos, uint16_t duration) {
+
+	uint16_t us = degToMicros(pos);
+	uint16_t ticks = duration / TRAJ_TICK;
+	uint8_t bit = (1<<ser);
+
+	servoWake(ser);
+
+	if(ticks == 0 || !(traj_known_mask & bit)) {
+		jumpServo(ser, us);
+		return;
+	}
+
+	traj_target[ser] = (int32_t)us << 8;
+	traj_vel[ser] = (traj_target[ser] - traj_pos[ser]) / ticks;
+	traj_ticks_left[ser] = ticks;
+
+	if(traj_active_mask == 0) last_traj_tick = hal_millis()-TRAJ_TICK;
+	traj_timed_mask |= bit;
+	traj_active_mask |= bit;
+
+}
+
+
+void RoboBrrd::updateTrajectories() {
+
+	if(traj_active_mask == 0 && traj_dirty_mask == 0) return;
+	if(hal_millis()-last_traj_tick < TRAJ_TICK) return;
+
+	// keep a fixed rate, unless we fell way behind
+	last_traj_tick += TRAJ_TICK;
+	if(hal_millis()-last_traj_tick >= TRAJ_TICK) last_traj_tick = hal_millis();
+
+	for(uint8_t i=0; i<4; i++) {
+		if(!(traj_active_mask & (1<<i))) continue;
+		if(!stepTrajectory(i)) traj_active_mask &= ~(1<<i);
+	}
+
+	flushServos();
+
+}
+
+
+// trapezoidal profile: speed up to the max speed, cruise, then brake
+// in time to stop on the target. returns false once it has arrived.
+bool RoboBrrd::stepTrajectory(uint8_t ser) {
+
+	// timed moves just glide along, and land exactly on the last tick
+	if(traj_timed_mask & (1<<ser)) {
+
+		traj_ticks_left[ser]--;
+
+		if(traj_ticks_left[ser] == 0) {
+			traj_pos[ser] = traj_target[ser];
+			traj_vel[ser] = 0;
+			traj_timed_mask &= ~(1<<ser);
+		} else {
+			traj_pos[ser] += traj_vel[ser];
+		}
+
+		traj_dirty_mask |= (1<<ser);
+
+		return (traj_ticks_left[ser] > 0);
+
+	}
+
+	int32_t err = traj_target[ser] - traj_pos[ser];
+	int32_t vel = traj_vel[ser];
+	int32_t accel = traj_accel[ser];
+
+	if(err == 0 && vel == 0) return false;
+
+	if((err >= 0 && vel < 0) || (err <= 0 && vel > 0)) {
+
+		// heading away from the target, brake before turning around
+		if(vel > 0) {
+			vel = (vel > accel) ? vel-accel : 0;
+		} else {
+			vel = (-vel > accel) ? vel+accel : 0;
+		}
+
+	} else {
+
+		uint32_t dist = (err < 0) ? -err : err;
+		uint32_t speed = (vel < 0) ? -vel : vel;
+
+		// distance it takes to stop from this speed, v^2/2a
+		uint32_t brake = (speed*speed) / (2*(uint32_t)accel) + speed/2;
+
+		if(dist <= brake) {
+			speed = (speed > (uint32_t)accel*2) ? speed-accel : accel;
+		} else if(speed < traj_max_vel[ser]) {
+			speed += accel;
+			if(speed > traj_max_vel[ser]) speed = traj_max_vel[ser];
+		}
+
+		vel = (err < 0) ? -(int32_t)speed : (int32_t)speed;
+
+	}
+
+	int32_t next = traj_pos[ser] + vel;
+
+	// snap onto the target instead of going past it
+	if((vel > 0 && next >= traj_target[ser] && err >= 0) || (vel < 0 && next <= traj_target[ser] && err <= 0)) {
+		next = traj_target[ser];
+		vel = 0;
+	}
+
+	traj_pos[ser] = next;
+	traj_vel[ser] = vel;
+
+	traj_dirty_mask |= (1<<ser);
+
+	return !(next == traj_target[ser] && vel == 0);
+
+}
+
+
+// waits for del ms, and keeps the trajectories going while it does
+void RoboBrrd::waitMotion(uint16_t del) {
+
+	// blocking moves can't wait for the tick
+	flushServos();
+
+	if(traj_active_mask == 0) {
+		hal_delay(del);
+		return;
+	}
+
+	long start = hal_millis();
+	while(hal_millis()-start < del) {
+		updateTrajectories();
+	}
+
+}
+
+
+/*
+ * Light Sensors
+ */
+
+void RoboBrrd::initLightSensors() {
+
+	if(LOG_LEVEL <= DEBUG) *debug_stream << "Calibrating light sensors" << endl;
+
+	recalibrateLightSensors();
+
+	// with a saved baseline it's good to go, and it keeps calibrating
+	if(loadLightCalibration()) {
+		if(LOG_LEVEL <= DEBUG) *debug_stream << "......Using the saved one for now" << endl;
+		light_calibration = LIGHT_SAVED;
+		return;
+	}
+
+	// blinky until it's done
+	setEyesHSI(hue_blue, 0.0, 1.0);
+	blinkEyes(100, 100, 0.8, 0);
+	calibration_blink = true;
+
+}
+
+
+// -- the next steady window becomes the baseline. the old baseline (if
+// there is one) is still used until then
+void RoboBrrd::recalibrateLightSensors() {
+
+	light_calibration = LIGHT_CALIBRATING;
+	calibration_start = hal_millis();
+	window_count = 0;
+	window_start = calibration_start;
+	window_steady = true;
+
+}
+
+
+void RoboBrrd::calibrateLightSensors() {
+
+	if(background_adc) drainADC();
+
+	// check if it is time to sample or not
+	if(hal_millis()-last_sampled < sample_time) return;
+
+	last_sampled = hal_millis();
+
+	// let's read the sensors now. one pass over all of the channels
+	bool first_sample = (sample_fill == 0);
+
+	for(uint8_t ch=0; ch<NUM_LDRS; ch++) {
+
+		previous_ldr_raw[ch] = current_ldr_raw[ch];
+
+		if(!background_adc) {
+
+			current_ldr_raw[ch] = hal_analogRead(ldr_pins[ch]);
+
+		} else {
+
+			// the average of what the adc read since last time (if it got to
+			// read anything, otherwise it stays the same)
+			if(adc_count[ch] > 0) current_ldr_raw[ch] = (adc_total[ch] + adc_count[ch]/2) / adc_count[ch];
+
+			adc_total[ch] = 0;
+			adc_count[ch] = 0;
+
+		}
+
+		uint16_t raw = current_ldr_raw[ch];
+
+		//if(LOG_LEVEL <= DEBUG) *debug_stream << "current raw " << ch << ": " << raw << " previous raw: " << previous_ldr_raw[ch] << endl; 
+
+		// let's see what the change in the raw val is. if the delta is not stable,
+		// this window won't be used to calibrate! (there's no previous val for the
+		// very first sample)
+		if(!first_sample) {
+
+			uint16_t raw_delta = math_abs(previous_ldr_raw[ch], raw);
+
+			if(raw_delta >= DELTA_THRESH) {
+				if(LOG_LEVEL <= DEBUG) *debug_stream << "too much delta in raw val " << ch << ": " << raw_delta << endl; 
+				window_steady = false;
+			}
+
+		}
+
+		// capture the min and max vals, and set any new ones
+		if(window_count == 0) {
+			ldr_min_raw[ch] = raw;
+			ldr_max_raw[ch] = raw;
+		}
+
+		if(raw < ldr_min_raw[ch]) ldr_min_raw[ch] = raw;
+		if(raw > ldr_max_raw[ch]) ldr_max_raw[ch] = raw;
+
+		// the new sample takes the place of the oldest one in the ring, so the
+		// running total only needs one add and one subtract
+		ldr_total[ch] += raw - ldr_ring[ch][sample_pos];
+		ldr_ring[ch][sample_pos] = raw;
+
+	}
+
+	sample_pos++;
+	if(sample_pos >= SAMPLE_SIZE) sample_pos = 0;
+	if(sample_fill < SAMPLE_SIZE) sample_fill++;
+
+	// the average is up to date after every sample
+	for(uint8_t ch=0; ch<NUM_LDRS; ch++) {
+		current_ldr_val[ch] = (ldr_total[ch] + sample_fill/2) / sample_fill;
+	}
+
+	// once per sample, so the debouncing counts samples
+	if(done_calibration) {
+		for(uint8_t ch=0; ch<NUM_LDRS; ch++) {
+			triggerLdr(ch);
+		}
+	}
+
+	// sample fast while something is happening, and slow down bit by bit
+	// once it's steady again
+	if(isLightActive()) {
+		sample_time = sample_time_min;
+	} else if(sample_time < sample_time_max) {
+		sample_time += (sample_time >> 2) + 1;
+		if(sample_time > sample_time_max) sample_time = sample_time_max;
+	}
+
+	window_count++;
+	if(hal_millis()-window_start < BASELINE_TIME) return;
+
+
+	// once a window, the average becomes the new baseline for the triggers
+	window_count = 0;
+	window_start = hal_millis();
+
+	// print it out
+	if(LOG_LEVEL <= INFO) {
+		for(uint8_t ch=0; ch<NUM_LDRS; ch++) {
+			*debug_stream << "current val " << ch << ": " << current_ldr_val[ch] << " min: " << ldr_min_raw[ch] << " max: " << ldr_max_raw[ch] << endl; 
+		}
+	}
+
+	// if it's taking too long, the average will have to do
+	bool timed_out = (light_calibration == LIGHT_CALIBRATING && hal_millis()-calibration_start >= CALIBRATION_TIMEOUT);
+
+	if(!window_steady && !timed_out) {
+		window_steady = true;
+		return;
+	}
+
+	for(uint8_t ch=0; ch<NUM_LDRS; ch++) {
+
+		previous_ldr_val[ch] = current_ldr_val[ch];
+
+		// calculate the new threshold values
+		bright_thresh[ch] = previous_ldr_val[ch] + BRIGHT_THRESH;
+		dark_thresh[ch] = previous_ldr_val[ch] - DARK_THRESH;
+
+		// let's hope these will save us some day
+		if( (int)previous_ldr_val[ch] + (int)BRIGHT_THRESH > 1023 ) bright_thresh[ch] = 1023;
+		if( (int)previous_ldr_val[ch] - (int)DARK_THRESH < 0 ) dark_thresh[ch] = 0;
+
+	}
+
+	// done for now!
+	done_calibration = true;
+
+	bool first = (light_calibration == LIGHT_CALIBRATING || light_calibration == LIGHT_SAVED);
+
+	if(first) {
+
+		if(LOG_LEVEL <= DEBUG) *debug_stream << "......Done" << endl;
+		if(!window_steady && LOG_LEVEL <= WARN) *debug_stream << "light sensors never settled, calibrated anyway" << endl;
+
+		// back to the default eyes, unless something else has changed them
+		if(calibration_blink && eye_anim == EYES_BLINK) ledsDefault();
+		calibration_blink = false;
+
+	}
+
+	// keep a good baseline for next time, but not too often
+	if(window_steady && (first || hal_millis()-last_calibration_save >= LDR_SAVE_INTERVAL)) {
+		saveLightCalibration();
+	}
+
+	light_calibration = window_steady ? LIGHT_CALIBRATED : LIGHT_TIMED_OUT;
+	window_steady = true;
+
+}
+
+
+// -- everything that's saved, in the order it's saved in: each field for
+// all of the channels, one field after another. the baselines go first
+void RoboBrrd::lightCalibrationVals(uint16_t **vals) {
+
+	uint16_t *fields[LDR_CAL_FIELDS] = {
+		previous_ldr_val,
+		ldr_min_raw,
+		ldr_max_raw,
+		dark_thresh,
+		bright_thresh
+	};
+
+	for(uint8_t f=0; f<LDR_CAL_FIELDS; f++) {
+		for(uint8_t ch=0; ch<NUM_LDRS; ch++) {
+			*vals++ = &fields[f][ch];
+		}
+	}
+
+}
+
+
+// -- only the bytes that changed are written. the checksum goes last, so
+// if the power goes out half way it won't be loaded
+void RoboBrrd::saveLightCalibration() {
+
+	if(!done_calibration) return;
+
+	uint16_t *vals[LDR_CAL_VALS];
+	lightCalibrationVals(vals);
+
+	uint8_t sum = LDR_CAL_STAMP;
+	hal_eepromUpdate(ldr_cal_addr, LDR_CAL_STAMP);
+
+	for(uint8_t i=0; i<LDR_CAL_VALS; i++) {
+		uint8_t lo = *vals[i] & 0xFF;
+		uint8_t hi = *vals[i] >> 8;
+		hal_eepromUpdate(ldr_cal_addr + 1 + i*2, lo);
+		hal_eepromUpdate(ldr_cal_addr + 2 + i*2, hi);
+		sum += lo + hi;
+	}
+
+	hal_eepromUpdate(ldr_cal_addr + 1 + LDR_CAL_VALS*2, ~sum);
+
+	last_calibration_save = hal_millis();
+
+	if(LOG_LEVEL <= DEBUG) *debug_stream << "saved light sensor calibration" << endl;
+
+}
+
+
+bool RoboBrrd::loadLightCalibration() {
+
+	if(hal_eepromRead(ldr_cal_addr) != LDR_CAL_STAMP) return false;
+
+	uint16_t loaded[LDR_CAL_VALS];
+	uint8_t sum = LDR_CAL_STAMP;
+
+	for(uint8_t i=0; i<LDR_CAL_VALS; i++) {
+		uint8_t lo = hal_eepromRead(ldr_cal_addr + 1 + i*2);
+		uint8_t hi = hal_eepromRead(ldr_cal_addr + 2 + i*2);
+		loaded[i] = ((uint16_t)hi << 8) | lo;
+		sum += lo + hi;
+	}
+
+	bool corrupt = ((uint8_t)~sum != hal_eepromRead(ldr_cal_addr + 1 + LDR_CAL_VALS*2));
+
+	// the baselines are first
+	for(uint8_t ch=0; ch<NUM_LDRS; ch++) {
+		if(loaded[ch] > 1023) corrupt = true;
+	}
+
+	if(corrupt) {
+		if(LOG_LEVEL <= WARN) *debug_stream << "saved light sensor calibration is corrupt" << endl;
+		return false;
+	}
+
+	uint16_t *vals[LDR_CAL_VALS];
+	lightCalibrationVals(vals);
+
+	for(uint8_t i=0; i<LDR_CAL_VALS; i++) {
+		*vals[i] = loaded[i];
+	}
+
+	done_calibration = true;
+
+	return true;
+
+}
+
+
+void RoboBrrd::forgetLightCalibration() {
+	hal_eepromUpdate(ldr_cal_addr, 0);
+}
+
+
+// -- changing since the last sample, near a trigger, or set off
+bool RoboBrrd::isLightActive() {
+
+	for(uint8_t ch=0; ch<NUM_LDRS; ch++) {
+
+		if(sample_fill > 1 && math_abs(previous_ldr_raw[ch], current_ldr_raw[ch]) >= ACTIVE_THRESH) return true;
+
+		if(!done_calibration) continue;
+
+		if(math_abs(previous_ldr_val[ch], current_ldr_val[ch]) >= ACTIVE_THRESH) return true;
+		if(ldr_state[ch] != LDR_NORMAL) return true;
+
+	}
+
+	return false;
+
+}
+
+
+void RoboBrrd::setLightSampleTime(uint16_t fast, uint16_t slow) {
+
+	if(fast == 0) fast = 1;
+	if(slow < fast) slow = fast;
+
+	sample_time_min = fast;
+	sample_time_max = slow;
+	sample_time = fast;
+
+}
+
+
+void RoboBrrd::enableBackgroundADC(bool tf) {
+
+	background_adc = tf;
+
+	for(uint8_t ch=0; ch<NUM_LDRS; ch++) {
+		adc_total[ch] = 0;
+		adc_count[ch] = 0;
+	}
+
+	if(tf) {
+		hal_adcStart(ldr_pins, NUM_LDRS);
+	} else {
+		hal_adcStop();
+	}
+
+}
+
+
+// -- called every update(), takes everything the adc has read so far. it
+// only holds HAL_ADC_BUFFER readings, so this can't wait too long
+void RoboBrrd::drainADC() {
+
+	uint8_t index;
+	uint16_t val;
+
+	// the index is the channel, since the adc has the same pins
+	while(hal_adcRead(&index, &val)) {
+		if(index >= NUM_LDRS) continue;
+		adc_total[index] += val;
+		adc_count[index]++;
+	}
+
+}
+
+
+// ldr states: 0 = normal, 1 = dark, 2 = bright (see LdrState)
+
+void RoboBrrd::triggerLdr(uint8_t ch) {
+
+	if(!updateLdrState(ch)) return;
+
+	if(ldr_state[ch] == LDR_DARK) {
+
+		if(LOG_LEVEL <= DEBUG) *debug_stream << "dark! (" << ch << ") " << current_ldr_val[ch] << " < " << dark_thresh[ch] << endl;
+
+		if(ldrDark[ch]) ldrDark[ch]();
+
+	} else if(ldr_state[ch] == LDR_BRIGHT) {
+
+		if(LOG_LEVEL <= DEBUG) *debug_stream << "bright! (" << ch << ") " << current_ldr_val[ch] << " > " << bright_thresh[ch] << endl;
+
+		if(ldrBright[ch]) ldrBright[ch]();
+
+	} else {
+
+		if(LOG_LEVEL <= DEBUG) *debug_stream << "normal (" << ch << ") " << current_ldr_val[ch] << endl;
+
+		if(ldrNormal[ch]) ldrNormal[ch]();
+
+	}
+
+}
+
+
+// -- called once per sample, returns true when the state changes. a new
+// state has to be seen in more than CHANGE_THRESH samples in a row (with
+// no gap of LDR_LAST_RESET ms or more) before it counts, and in the raw
+// sample as well as the average. one bad sample drags the average along
+// for the whole ring, but the raw samples after it don't agree, so a
+// flicker doesn't set it off
+bool RoboBrrd::updateLdrState(uint8_t ch) {
+
+	uint16_t dark = dark_thresh[ch];
+	uint16_t bright = bright_thresh[ch];
+
+	// -- the thresholds are further away on the way back, so it doesn't
+	// flip back and forth when it's right on one of them
+	if(ldr_state[ch] == LDR_DARK) dark += LDR_HYSTERESIS;
+	if(ldr_state[ch] == LDR_BRIGHT) bright = (bright > LDR_HYSTERESIS) ? bright - LDR_HYSTERESIS : 0;
+
+	uint8_t seen = ldrLevel(current_ldr_val[ch], dark, bright);
+
+	if(seen == ldr_state[ch] || ldrLevel(current_ldr_raw[ch], dark, bright) != seen) {
+		trigger_sample[ch] = 0;
+		return false;
+	}
+
+	// reset the counter if this is the first trigger in quite some time
+	if(hal_millis()-last_trigger[ch] >= LDR_LAST_RESET) {
+		trigger_sample[ch] = 0;
+	}
+
+	// increment and record the trigger...
+	trigger_sample[ch]++;
+	last_trigger[ch] = hal_millis();
+
+	// if we exceed the specific number of threshold changes, then set the new state!
+	if(trigger_sample[ch] <= CHANGE_THRESH) return false;
+
+	trigger_sample[ch] = 0;
+	ldr_state[ch] = seen;
+
+	return true;
+
+}
+
+
+uint8_t RoboBrrd::ldrLevel(uint16_t val, uint16_t dark, uint16_t bright) {
+	if(val < dark) return LDR_DARK;
+	if(val > bright) return LDR_BRIGHT;
+	return LDR_NORMAL;
+}
+
+
+uint16_t RoboBrrd::math_abs(uint16_t a, uint16_t b) {
+  
+  // for some reason the abs() function is giving us a negative number,
+  // even though we are not passing a function to the macro. weird behaviour.
+  // it is seemingly because it is not ordering the numbers properly.
+  
+  if(a > b) return abs(a-b);
+  
+  if(b > a) return abs(b-a);
+  
+  return 0;
+
+}
+
+
+
+
+/**
+ * Emote
+ */
+
+void RoboBrrd::saveMood() {
+	hal_eepromWrite(mood_addr[0], emote_happy);
+	hal_eepromWrite(mood_addr[1], emote_chill);
+}
+
+void RoboBrrd::saveState() {
+	hal_eepromWrite(state_addr[0], emote_food);
+	hal_eepromWrite(state_addr[1], emote_water);
+	hal_eepromWrite(state_addr[2], emote_play);
+}
+
+void RoboBrrd::setMood(uint8_t happy, uint8_t chill) {
+	emote_happy = happy;
+	emote_chill = chill;
+}
+
+void RoboBrrd::setState(uint8_t food, uint8_t water, uint8_t play) {
+	emote_food = food;
+	emote_water = water;
+	emote_play = play;
+}
+
+void RoboBrrd::initEmotes() {
+
+	if(LOG_LEVEL <= DEBUG) Serial << "Starting emotes";
+
+	emote_happy = hal_eepromRead(mood_addr[0]);
+	emote_chill = hal_eepromRead(mood_addr[1]);
+
+	emote_food = hal_eepromRead(state_addr[0]);
+	emote_water = hal_eepromRead(state_addr[1]);
+	emote_play = hal_eepromRead(state_addr[2]);
+
+	setEmotePlay(emote_play+20); // here's a treat for being initialised, yum yum
+
+	if(LOG_LEVEL <= DEBUG) Serial << "......Done" << endl;
+
+}
+
+
+
+
+/*
+ * LED Eyes Functions
+ */
+
+void RoboBrrd::ledsDefault() {
+	uint8_t def_red = hal_eepromRead(led_addr[0]);
+	uint8_t def_green = hal_eepromRead(led_addr[1]);
+	uint8_t def_blue = hal_eepromRead(led_addr[2]);
+
+	setEyesRGB(def_red, def_green, def_blue);
+}
+
+
+void RoboBrrd::saveLedsDefault() {
+	hal_eepromWrite(led_addr[0], current_rgb[0]);
+	hal_eepromWrite(led_addr[1], current_rgb[1]);
+	hal_eepromWrite(led_addr[2], current_rgb[2]);
+}
+
+
+void RoboBrrd::setEyesRGB(uint8_t r, uint8_t g, uint8_t b) {
+  
+  eye_anim = EYES_STILL;
+
+  // the hsi is only worked out if someone asks for it
+  showEyes(r, g, b);
+  
+}
+
+
+void RoboBrrd::setEyesHSI(float h, float s, float i) {
+  
+  eye_anim = EYES_STILL;
+
+  // -- the float part is just scaling, the colour math is all integers
+  long h8 = (long)(h * 8.0 + 0.5) % HSI_HUE_STEPS;
+  if(h8 < 0) h8 += HSI_HUE_STEPS;
+  uint8_t s8 = (uint8_t)((s>0?(s<1?s:1):0) * 255.0 + 0.5);
+  uint8_t i8 = (uint8_t)((i>0?(i<1?i:1):0) * 255.0 + 0.5);
+
+  showEyesHSI((uint16_t)h8, s8, i8);
+  
+}
+
+
+void RoboBrrd::getEyesRGB(uint8_t *rgb) {
+  rgb[0] = current_rgb[0];
+  rgb[1] = current_rgb[1];
+  rgb[2] = current_rgb[2];
+}
+
+
+// H in degrees, S and I 0.0-1.0 (the same as setEyesHSI)
+void RoboBrrd::getEyesHSI(float *hsi) {
+  updateEyesHSI();
+  hsi[0] = current_hue / 8.0;
+  hsi[1] = current_sat / 255.0;
+  hsi[2] = current_int / 255.0;
+}
+
+
+void RoboBrrd::setMaxBrightness(float b) {
+
+  uint8_t bright = (uint8_t)((b>0?(b<1?b:1):0) * 255.0 + 0.5);
+  if(bright == max_brightness) return;
+
+  max_brightness = bright;
+
+  // -- show it straight away, unless an animation is about to anyway
+  if(eye_anim == EYES_STILL) writeEyes12(led_in12[0], led_in12[1], led_in12[2]);
+
+}
+
+
+void RoboBrrd::setEyesGamma(bool tf) {
+
+  if(tf == eyes_gamma) return;
+
+  eyes_gamma = tf;
+
+  if(eye_anim == EYES_STILL) writeEyes12(led_in12[0], led_in12[1], led_in12[2]);
+
+}
+
+
+// -- like setEyesRGB, but 0-4095 for finer steps. use this with dithering
+void RoboBrrd::setEyesRGB12(uint16_t r, uint16_t g, uint16_t b) {
+
+  if(r > 4095) r = 4095;
+  if(g > 4095) g = 4095;
+  if(b > 4095) b = 4095;
+
+  eye_anim = EYES_STILL;
+
+  current_rgb[0] = r >> 4;
+  current_rgb[1] = g >> 4;
+  current_rgb[2] = b >> 4;
+  current_hsi_valid = false;
+
+  writeEyes12(r, g, b);
+
+}
+
+
+// -- the pwm is only 8 bits, so dim colours only have a few levels to
+// choose from. with dithering on, the output flips between the two
+// nearest levels every ms so that on average it's right to 12 bits
+void RoboBrrd::setEyesDither(bool tf) {
+
+  if(tf == eyes_dither) return;
+
+  eyes_dither = tf;
+
+  for(uint8_t i=0; i<3; i++) {
+    led_dither_acc[i] = 0;
+  }
+
+  writeEyes12(led_in12[0], led_in12[1], led_in12[2]);
+
+}
+
+
+// (i/255)^2.2, in 12 bits
+static const uint16_t led_gamma[256] PROGMEM = {
+	0, 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 5, 6, 7, 8,
+	9, 11, 12, 14, 15, 17, 19, 21, 23, 25, 27, 29, 32, 34, 37, 40,
+	43, 46, 49, 52, 55, 59, 62, 66, 70, 73, 77, 82, 86, 90, 95, 99,
+	104, 109, 114, 119, 124, 129, 135, 140, 146, 152, 158, 164, 170, 176, 182, 189,
+	196, 202, 209, 216, 224, 231, 238, 246, 254, 261, 269, 277, 286, 294, 302, 311,
+	320, 328, 337, 347, 356, 365, 375, 384, 394, 404, 414, 424, 435, 445, 456, 467,
+	477, 488, 500, 511, 522, 534, 545, 557, 569, 581, 594, 606, 619, 631, 644, 657,
+	670, 683, 697, 710, 724, 738, 752, 766, 780, 794, 809, 823, 838, 853, 868, 884,
+	899, 914, 930, 946, 962, 978, 994, 1011, 1027, 1044, 1061, 1078, 1095, 1112, 1130, 1147,
+	1165, 1183, 1201, 1219, 1237, 1256, 1274, 1293, 1312, 1331, 1350, 1370, 1389, 1409, 1429, 1449,
+	1469, 1489, 1509, 1530, 1551, 1572, 1593, 1614, 1635, 1657, 1678, 1700, 1722, 1744, 1766, 1789,
+	1811, 1834, 1857, 1880, 1903, 1926, 1950, 1974, 1997, 2021, 2045, 2070, 2094, 2119, 2143, 2168,
+	2193, 2219, 2244, 2270, 2295, 2321, 2347, 2373, 2400, 2426, 2453, 2479, 2506, 2534, 2561, 2588,
+	2616, 2644, 2671, 2700, 2728, 2756, 2785, 2813, 2842, 2871, 2900, 2930, 2959, 2989, 3019, 3049,
+	3079, 3109, 3140, 3170, 3201, 3232, 3263, 3295, 3326, 3358, 3390, 3421, 3454, 3486, 3518, 3551,
+	3584, 3617, 3650, 3683, 3716, 3750, 3784, 3818, 3852, 3886, 3920, 3955, 3990, 4025, 4060, 4095
+};
+
+
+// -- what actually gets written for a level, with gamma and brightness.
+// straight from the table in flash, it's only a multiply
+uint8_t RoboBrrd::ledLevel(uint8_t in) {
+  uint16_t g = eyes_gamma ? pgm_read_word(&led_gamma[in]) : (in << 4) | (in >> 4);
+  return ((uint32_t)g * (max_brightness + 1)) >> 12;
+}
+
+
+// -- everything that goes to the leds comes through here. only the pins
+// that changed get written
+void RoboBrrd::writeEyes(uint8_t r, uint8_t g, uint8_t b) {
+
+  uint8_t rgb[3] = { r, g, b };
+
+  for(uint8_t i=0; i<3; i++) {
+    led_in12[i] = (rgb[i] << 4) | (rgb[i] >> 4);
+  }
+
+  if(eyes_dither) {
+    writeEyes12(led_in12[0], led_in12[1], led_in12[2]);
+    return;
+  }
+
+  for(uint8_t i=0; i<3; i++) {
+
+    uint8_t out = ledLevel(rgb[i]);
+    if(out == last_led_rgb[i]) continue;
+
+    last_led_rgb[i] = out;
+    hal_analogWrite(led_pins[i], out);
+
+  }
+
+}
+
+
+// -- writes the leds again even if they haven't changed, for when
+// something else has been using their timers
+void RoboBrrd::refreshEyes() {
+  for(uint8_t i=0; i<3; i++) {
+    hal_analogWrite(led_pins[i], last_led_rgb[i]);
+  }
+}
+
+
+// -- the 12 bit version. without dithering it's just rounded down
+void RoboBrrd::writeEyes12(uint16_t r, uint16_t g, uint16_t b) {
+
+  uint16_t rgb[3] = { r, g, b };
+
+  for(uint8_t i=0; i<3; i++) {
+
+    led_in12[i] = rgb[i];
+    led_out12[i] = ledLevel12(rgb[i]);
+
+    if(eyes_dither) continue;
+
+    uint8_t out = led_out12[i] >> 4;
+    if(out == last_led_rgb[i]) continue;
+
+    last_led_rgb[i] = out;
+    hal_analogWrite(led_pins[i], out);
+
+  }
+
+  if(eyes_dither) {
+    last_dither = hal_millis() - 1;
+    ditherEyes();
+  }
+
+}
+
+
+// -- gamma and brightness for a 0-4095 level, going between the entries
+// of the gamma table
+uint16_t RoboBrrd::ledLevel12(uint16_t in) {
+
+  uint16_t g = in;
+
+  if(eyes_gamma) {
+    uint8_t idx = in >> 4;
+    uint16_t g0 = pgm_read_word(&led_gamma[idx]);
+    uint16_t g1 = (idx < 255) ? pgm_read_word(&led_gamma[idx+1]) : g0;
+    g = g0 + (((g1 - g0) * (in & 0x0F)) >> 4);
+  }
+
+  return ((uint32_t)g * (max_brightness + 1)) >> 8;
+
+}
+
+
+// -- called from update(). first order sigma-delta: the bottom 4 bits
+// build up, and each time they carry over the output goes up by one for
+// a frame. only a few adds per channel
+void RoboBrrd::ditherEyes() {
+
+  if(!eyes_dither) return;
+
+  unsigned long now = hal_millis();
+  if(now == last_dither) return;
+  last_dither = now;
+
+  for(uint8_t i=0; i<3; i++) {
+
+    uint8_t acc = led_dither_acc[i] + (led_out12[i] & 0x0F);
+    uint16_t out = (led_out12[i] >> 4) + (acc >> 4);
+    led_dither_acc[i] = acc & 0x0F;
+
+    if(out > 255) out = 255;
+    if(out == last_led_rgb[i]) continue;
+
+    last_led_rgb[i] = out;
+    hal_analogWrite(led_pins[i], out);
+
+  }
+
+}
+
+
+// cos(h)/cos(60-h) for each degree of a 120 degree sector, in Q12 (4096 = 1.0)
+static const int16_t hsi_ratio[121] PROGMEM = {
+	8192, 7952, 7725, 7510, 7307, 7114, 6930, 6755, 6588, 6428,
+	6275, 6129, 5988, 5852, 5721, 5595, 5474, 5356, 5242, 5132,
+	5024, 4920, 4819, 4721, 4625, 4532, 4441, 4352, 4265, 4179,
+	4096, 4014, 3934, 3855, 3778, 3702, 3627, 3554, 3481, 3410,
+	3339, 3269, 3201, 3133, 3065, 2998, 2932, 2867, 2802, 2738,
+	2673, 2610, 2547, 2484, 2421, 2358, 2296, 2234, 2172, 2110,
+	2048, 1986, 1924, 1862, 1800, 1738, 1675, 1612, 1549, 1486,
+	1423, 1358, 1294, 1229, 1164, 1098, 1031, 963, 895, 827,
+	757, 686, 615, 542, 469, 394, 318, 241, 162, 82,
+	0, -83, -169, -256, -345, -436, -529, -625, -723, -824,
+	-928, -1036, -1146, -1260, -1378, -1499, -1625, -1756, -1892, -2033,
+	-2179, -2332, -2492, -2659, -2834, -3018, -3211, -3414, -3629, -3856,
+	-4096
+};
+
+
+// Based on the float version by Brian Neltner from Saikoled
+// http://blog.saikoled.com/post/43693602826/why-every-led-light-should-be-using-hsi-colorspace
+// H is in 1/8 degrees (0-2879), S and I are 0-255. Within 1 of the float
+// version, with no trig or division (see extras/host/hsi_bench.cpp).
+void RoboBrrd::hsi2rgb(uint16_t H, uint8_t S, uint8_t I, uint8_t *rgb) {
+
+  if(H >= HSI_HUE_STEPS) H %= HSI_HUE_STEPS;
+
+  // -- which third of the colour wheel, and how far into it
+  uint8_t sector = 0;
+  while(H >= HSI_HUE_STEPS/3) {
+    H -= HSI_HUE_STEPS/3;
+    sector++;
+  }
+
+  // -- ratio between the two table entries either side of the hue
+  uint8_t idx = H >> 3;
+  uint8_t frac = H & 0x07;
+  int16_t r0 = (int16_t)pgm_read_word(&hsi_ratio[idx]);
+  int16_t r1 = (int16_t)pgm_read_word(&hsi_ratio[idx+1]);
+  int16_t ratio = r0 + (((int16_t)(r1 - r0) * frac) >> 3);
+
+  // -- 255*I/3*(1 + S*ratio), 255*I/3*(1 + S*(1-ratio)) and 255*I/3*(1-S)
+  // all scaled up by 255*4096. dividing by 3*255*4096 is >>12 then *21932 >>24
+  uint32_t one = 255UL*4096;
+  uint32_t a = (uint32_t)I * (one + (int32_t)S * ratio);
+  uint32_t b = (uint32_t)I * (one + (int32_t)S * (4096 - ratio));
+  uint32_t c = (uint32_t)I * (255 - S) * 4096;
+
+  uint8_t x = ((a >> 12) * 21932UL) >> 24;
+  uint8_t y = ((b >> 12) * 21932UL) >> 24;
+  uint8_t z = ((c >> 12) * 21932UL) >> 24;
+
+  switch(sector) {
+    case 0:
+      rgb[0] = x; rgb[1] = y; rgb[2] = z;
+    break;
+    case 1:
+      rgb[1] = x; rgb[2] = y; rgb[0] = z;
+    break;
+    default:
+      rgb[2] = x; rgb[0] = y; rgb[1] = z;
+    break;
+  }
+
+}
+
+
+// The other way round. Grey has no hue, so H is left alone then (pass
+// in the last one). Colours brighter than I = 1.0 (like white, which
+// adds up to more than 255) come back as I = 255.
+void RoboBrrd::rgb2hsi(uint8_t r, uint8_t g, uint8_t b, uint16_t *H, uint8_t *S, uint8_t *I) {
+
+  uint16_t sum = r + g + b;
+  uint8_t lo = min(r, min(g, b));
+
+  *I = (sum > 255) ? 255 : sum;
+
+  if(sum == 0 || sum == 3*lo) {
+    *S = 0;
+    return;
+  }
+
+  *S = 255 - (((uint32_t)lo * 3 * 255 + sum/2) / sum);
+
+  // -- the smallest channel says which third of the wheel it's in, and
+  // the x channel (see hsi2rgb) says where
+  uint8_t x;
+  uint16_t base;
+  if(b == lo) {
+    x = r;
+    base = 0;
+  } else if(r == lo) {
+    x = g;
+    base = HSI_HUE_STEPS/3;
+  } else {
+    x = b;
+    base = 2*HSI_HUE_STEPS/3;
+  }
+
+  int32_t ratio = ((int32_t)(3*x - sum) << 12) / (int32_t)(sum - 3*lo);
+
+  // -- the table goes down as the hue goes up, so look for where it
+  // crosses the ratio and go between the two entries
+  uint8_t lo_idx = 0;
+  uint8_t hi_idx = 120;
+  while(hi_idx - lo_idx > 1) {
+    uint8_t mid = (lo_idx + hi_idx) >> 1;
+    if((int16_t)pgm_read_word(&hsi_ratio[mid]) >= ratio) {
+      lo_idx = mid;
+    } else {
+      hi_idx = mid;
+    }
+  }
+
+  int16_t r0 = (int16_t)pgm_read_word(&hsi_ratio[lo_idx]);
+  int16_t r1 = (int16_t)pgm_read_word(&hsi_ratio[hi_idx]);
+  int32_t frac = 0;
+  if(r0 != r1) frac = ((int32_t)(r0 - ratio) * 8 + (r0 - r1)/2) / (r0 - r1);
+  if(frac < 0) frac = 0;
+  if(frac > 8) frac = 8;
+
+  uint16_t h = base + lo_idx*8 + frac;
+  if(h >= HSI_HUE_STEPS) h -= HSI_HUE_STEPS;
+  *H = h;
+
+}
+
+
+// -- only done when something needs the hsi after an rgb colour was set
+void RoboBrrd::updateEyesHSI() {
+  if(current_hsi_valid) return;
+  rgb2hsi(current_rgb[0], current_rgb[1], current_rgb[2], &current_hue, &current_sat, &current_int);
+  current_hsi_valid = true;
+}
+
+
+/**
+ * Eye Animations
+ */
+
+// -- fade from whatever colour the eyes are now
+void RoboBrrd::fadeEyesRGB(uint8_t r, uint8_t g, uint8_t b, uint16_t duration) {
+
+	for(uint8_t i=0; i<3; i++) {
+		eye_from[i] = current_rgb[i];
+	}
+	eye_to[0] = r;
+	eye_to[1] = g;
+	eye_to[2] = b;
+
+	startEyes(EYES_FADE_RGB, duration);
+
+}
+
+
+// -- same, but around the colour wheel instead of straight across it
+void RoboBrrd::fadeEyesHSI(float h, float s, float i, uint16_t duration) {
+
+	eyesHSIFromCurrent();
+
+	long h8 = (long)(h * 8.0 + 0.5) % HSI_HUE_STEPS;
+	if(h8 < 0) h8 += HSI_HUE_STEPS;
+	eye_to_h = h8;
+	eye_to[0] = (uint8_t)((s>0?(s<1?s:1):0) * 255.0 + 0.5);
+	eye_to[1] = (uint8_t)((i>0?(i<1?i:1):0) * 255.0 + 0.5);
+
+	startEyes(EYES_FADE_HSI, duration);
+
+}
+
+
+// -- on for on_ms, then dimmed to dim (0.0-1.0) of the colour for off_ms.
+// times 0 = keep blinking until something else happens to the eyes
+void RoboBrrd::blinkEyes(uint16_t on_ms, uint16_t off_ms, float dim, uint8_t times) {
+
+	for(uint8_t i=0; i<3; i++) {
+		eye_from[i] = current_rgb[i];
+	}
+	eye_anim_time2 = off_ms;
+	eye_anim_times = times;
+	eye_anim_level = (uint8_t)((dim>0?(dim<1?dim:1):0) * 255.0 + 0.5);
+
+	startEyes(EYES_BLINK, on_ms);
+
+}
+
+
+// -- slowly dims down to low (0.0-1.0) and back up again, every period
+void RoboBrrd::breatheEyes(uint16_t period, float low) {
+
+	for(uint8_t i=0; i<3; i++) {
+		eye_from[i] = current_rgb[i];
+	}
+	eye_anim_level = (uint8_t)((low>0?(low<1?low:1):0) * 255.0 + 0.5);
+
+	startEyes(EYES_BREATHE, period);
+
+}
+
+
+// -- all the way round the colour wheel every period, keeping S and I
+void RoboBrrd::cycleEyesHue(uint16_t period) {
+
+	eyesHSIFromCurrent();
+
+	startEyes(EYES_HUE_CYCLE, period);
+
+}
+
+
+void RoboBrrd::stopEyes() {
+
+	// blink and breathe leave the colour where it started
+	if(eye_anim == EYES_BLINK || eye_anim == EYES_BREATHE) {
+		eye_anim = EYES_STILL;
+		showEyes(eye_from[0], eye_from[1], eye_from[2]);
+	}
+
+	eye_anim = EYES_STILL;
+
+}
+
+
+void RoboBrrd::startEyes(uint8_t anim, uint16_t duration) {
+
+	if(duration == 0) duration = 1;
+
+	eye_anim = anim;
+	eye_anim_time = duration;
+	eye_anim_start = hal_millis();
+	last_eye_frame = eye_anim_start - EYES_FRAME;
+
+	updateEyes();
+
+}
+
+
+void RoboBrrd::eyesHSIFromCurrent() {
+
+	updateEyesHSI();
+
+	eye_from_h = current_hue;
+	eye_from[0] = current_sat;
+	eye_from[1] = current_int;
+
+}
+
+
+// -- called from update(), draws a frame every EYES_FRAME ms. everything
+// is worked out from the time since the start, so a late frame catches up
+void RoboBrrd::updateEyes() {
+
+	if(eye_anim == EYES_STILL) return;
+	if(hal_millis()-last_eye_frame < EYES_FRAME) return;
+
+	last_eye_frame = hal_millis();
+
+	unsigned long elapsed = last_eye_frame - eye_anim_start;
+	uint8_t rgb[3];
+	uint16_t level = 256;
+	bool done = false;
+	bool hsi = false;
+	uint16_t h = 0;
+	uint8_t sat = 0;
+	uint8_t inten = 0;
+
+	switch(eye_anim) {
+
+		case EYES_FADE_RGB:
+		case EYES_FADE_HSI: {
+
+			// -- how far through, 0-256
+			int16_t p = 256;
+			if(elapsed < eye_anim_time) {
+				p = ((uint32_t)elapsed << 8) / eye_anim_time;
+			} else {
+				done = true;
+			}
+
+			if(eye_anim == EYES_FADE_RGB) {
+
+				for(uint8_t i=0; i<3; i++) {
+					rgb[i] = eye_from[i] + (((int16_t)(eye_to[i] - eye_from[i]) * p) >> 8);
+				}
+
+			} else {
+
+				// -- the short way round
+				int16_t dh = (int16_t)eye_to_h - (int16_t)eye_from_h;
+				if(dh > (int16_t)HSI_HUE_STEPS/2) dh -= HSI_HUE_STEPS;
+				if(dh < -(int16_t)HSI_HUE_STEPS/2) dh += HSI_HUE_STEPS;
+
+				int16_t hs = eye_from_h + (int16_t)(((int32_t)dh * p) >> 8);
+				if(hs < 0) hs += HSI_HUE_STEPS;
+				if(hs >= (int16_t)HSI_HUE_STEPS) hs -= HSI_HUE_STEPS;
+
+				h = hs;
+				sat = eye_from[0] + (((int16_t)(eye_to[0] - eye_from[0]) * p) >> 8);
+				inten = eye_from[1] + (((int16_t)(eye_to[1] - eye_from[1]) * p) >> 8);
+				hsi = true;
+
+			}
+
+		}
+		break;
+
+		case EYES_BLINK: {
+
+			unsigned long cycle = (unsigned long)eye_anim_time + eye_anim_time2;
+
+			if(eye_anim_times != 0 && elapsed / cycle >= eye_anim_times) {
+				done = true;
+			} else if(elapsed % cycle >= eye_anim_time) {
+				level = eye_anim_level + 1;
+			}
+
+			for(uint8_t i=0; i<3; i++) {
+				rgb[i] = (eye_from[i] * level) >> 8;
+			}
+
+		}
+		break;
+
+		case EYES_BREATHE: {
+
+			// -- starts bright, eases down and back up
+			uint8_t phase = ((uint32_t)(elapsed % eye_anim_time) << 8) / eye_anim_time;
+			uint8_t tri = (phase < 128) ? 255 - (phase << 1) : (phase << 1) - 255;
+			uint8_t eased = 255 - (((uint16_t)(255 - tri) * (255 - tri)) >> 8);
+
+			level = eye_anim_level + 1 + (((uint16_t)(255 - eye_anim_level) * eased) >> 8);
+
+			for(uint8_t i=0; i<3; i++) {
+				rgb[i] = (eye_from[i] * level) >> 8;
+			}
+
+		}
+		break;
+
+		case EYES_HUE_CYCLE: {
+
+			h = eye_from_h + ((uint32_t)(elapsed % eye_anim_time) * HSI_HUE_STEPS) / eye_anim_time;
+			if(h >= HSI_HUE_STEPS) h -= HSI_HUE_STEPS;
+
+			sat = eye_from[0];
+			inten = eye_from[1];
+			hsi = true;
+
+		}
+		break;
+
+		default:
+		return;
+
+	}
+
+	if(hsi) {
+		showEyesHSI(h, sat, inten);
+	} else {
+		showEyes(rgb[0], rgb[1], rgb[2]);
+	}
+
+	if(done) eye_anim = EYES_STILL;
+
+}
+
+
+void RoboBrrd::showEyes(uint8_t r, uint8_t g, uint8_t b) {
+
+	// blink and breathe dim the colour, they don't change it
+	if(eye_anim != EYES_BLINK && eye_anim != EYES_BREATHE) {
+		current_rgb[0] = r;
+		current_rgb[1] = g;
+		current_rgb[2] = b;
+		current_hsi_valid = false;
+	}
+
+	writeEyes(r, g, b);
+
+}
+
+
+// -- hsi is kept as it was given, so there's nothing lost going back and forth
+void RoboBrrd::showEyesHSI(uint16_t h, uint8_t s, uint8_t i) {
+
+	uint8_t rgb[3];
+
+	hsi2rgb(h, s, i, rgb);
+	showEyes(rgb[0], rgb[1], rgb[2]);
+
+	current_hue = h;
+	current_sat = s;
+	current_int = i;
+	current_hsi_valid = true;
+
+}
+
+
+
+
+/**
+ * Speaker
+ */
+
+void RoboBrrd::robotgrrlSong() {
+  playMelody(MELODY_ROBOTGRRL);
+}
+
+
+// -- tone is half of the period of the wave in us (so 500 is 1kHz), and
+// duration is in ms. it doesn't wait: tones queue up and play one after
+// the other while update() runs
+void RoboBrrd::playTone(uint16_t tone, uint16_t duration) {
+  enqueueTone(tone, duration, 0);
+}
+
+
+void RoboBrrd::stopTone() {
+
+  melody_ptr = NULL;
+  tone_count = 0;
+  hal_toneStop();
+  next_tone = hal_millis();
+
+}
+
+
+bool RoboBrrd::isTonePlaying() {
+  return tone_count > 0 || hal_tonePlaying() || (long)(hal_millis() - next_tone) < 0;
+}
+
+
+// -- from is where the chirp starts and to is where it ends, in Hz. it
+// plays from the synth instead of as a square wave, so it can slide and
+// fade in and out (see setChirpEnvelope)
+void RoboBrrd::playChirp(uint16_t from, uint16_t to, uint16_t duration, uint8_t wave, uint8_t gap) {
+
+  ToneCmd *t = nextToneCmd();
+  if(t == NULL) return;
+
+  t->tone = from;
+  t->tone_to = to;
+  t->duration = duration;
+  t->gap = gap;
+  t->wave = wave;
+  tone_count++;
+
+  updateSpeaker();
 
-void RoboBrrd::rotateLeft() {
-	servoMove(ROTATION_SERVO, rot_pos[1], 200);
 }
 
-void RoboBrrd::rotateRight() {
-	servoMove(ROTATION_SERVO, rot_pos[2], 200);
+
+// -- attack and release are how many ms the chirps take to fade in and
+// out, volume is 0-255
+void RoboBrrd::setChirpEnvelope(uint8_t attack, uint8_t release, uint8_t volume) {
+  chirp_attack = attack;
+  chirp_release = release;
+  chirp_volume = volume;
 }
 
-void RoboBrrd::rotateHome() {
-	servoMove(ROTATION_SERVO, rot_pos[0], 150);
+
+void RoboBrrd::tweet() {
+  playChirp(2200, 3800, 60, SYNTH_SINE, 40);
+  playChirp(2400, 4000, 60, SYNTH_SINE, 40);
+  playChirp(4200, 2000, 140, SYNTH_TRIANGLE, 0);
 }
 
-void RoboBrrd::shakeShake() {
 
-	for(uint8_t i=0; i<4; i++) {
-		servoMove(ROTATION_SERVO, rot_pos[1], 300);
-		servoMove(ROTATION_SERVO, rot_pos[2], 300);
-	}
+// -- the free spot at the end of the queue, or NULL if it's full
+RoboBrrd::ToneCmd *RoboBrrd::nextToneCmd() {
+
+  if(tone_count >= TONE_QUEUE_SIZE) {
+    tone_overflows++;
+    return NULL;
+  }
 
-	servoMove(ROTATION_SERVO, rot_pos[0], 150);
+  return &tone_queue[(tone_head + tone_count) % TONE_QUEUE_SIZE];
 
 }
 
-void RoboBrrd::rotateBounce() {
-
-	uint8_t boing1 = 0;
-	uint8_t boing2 = 0;
 
-	if(rot_pos[1] < rot_pos[0]) { // 0 < 90
-		boing1 = rot_pos[1] + 20;
-	} else {
-		boing1 = rot_pos[1] - 20;
-	}
+void RoboBrrd::enqueueTone(uint16_t tone, uint16_t duration, uint8_t gap) {
 
-	if(rot_pos[2] > rot_pos[0]) { // 180 > 90
-		boing2 = rot_pos[2] - 20;
-	} else {
-		boing2 = rot_pos[2] + 20;
-	}
+  ToneCmd *t = nextToneCmd();
+  if(t == NULL) return;
 
-	servoMove(ROTATION_SERVO, rot_pos[1], 300);
+  t->tone = tone;
+  t->tone_to = tone;
+  t->duration = duration;
+  t->gap = gap;
+  t->wave = TONE_SQUARE;
+  tone_count++;
 
-	for(uint8_t i=0; i<3; i++) {
-		servoMove(ROTATION_SERVO, boing1, 50);
-		servoMove(ROTATION_SERVO, rot_pos[1], 50);
-	}
+  // -- start it now if nothing else is playing
+  updateSpeaker();
 
-	servoMove(ROTATION_SERVO, rot_pos[2], 300);
+}
 
-	for(uint8_t i=0; i<3; i++) {
-		servoMove(ROTATION_SERVO, boing2, 50);
-		servoMove(ROTATION_SERVO, rot_pos[2], 50);
-	}
 
-	servoMove(ROTATION_SERVO, rot_pos[0], 150);
+void RoboBrrd::updateSpeaker() {
 
-}
+  if(hal_tonePlaying()) return;
 
-void RoboBrrd::rotatePos(uint8_t pos) {
-	servoMove(ROTATION_SERVO, pos, 100);	
-}
+  // timer 2 is back to doing pwm, so the eye on it needs to be written again
+  if(tone_started) {
+    tone_started = false;
+    refreshEyes();
+  }
 
+  if((long)(hal_millis() - next_tone) < 0) return;
+  if(tone_count == 0) return;
 
+  ToneCmd *t = &tone_queue[tone_head];
+  tone_head = (tone_head + 1) % TONE_QUEUE_SIZE;
+  tone_count--;
 
-// -- right wing
+  // a tone of 0 is a rest
+  if(t->tone != 0 && t->wave == TONE_SQUARE) {
 
-void RoboBrrd::rightWingUp() {
-	servoMove(RWING_SERVO, rwing_pos[1], 100);
-}
+    hal_toneStart(spkr_pin, t->tone, t->duration);
+    tone_started = true;
 
-void RoboBrrd::rightWingDown() {
-	servoMove(RWING_SERVO, rwing_pos[2], 100);
-}
+  } else if(t->tone != 0) {
 
-void RoboBrrd::rightWingHome() {
-	servoMove(RWING_SERVO, rwing_pos[0], 100);
-}
+    SynthChirp c;
+    c.from = t->tone;
+    c.to = t->tone_to;
+    c.duration = t->duration;
+    c.wave = t->wave;
+    c.attack = chirp_attack;
+    c.release = chirp_release;
+    c.volume = chirp_volume;
 
-void RoboBrrd::rightWingWave() {
+    hal_synthStart(spkr_pin, &c);
+    tone_started = true;
 
-	for(uint8_t i=0; i<3; i++) {
-		servoMove(RWING_SERVO, rwing_pos[1], 150);
-		servoMove(RWING_SERVO, rwing_pos[2], 150);
-	}
+  }
 
-	servoMove(RWING_SERVO, rwing_pos[0], 80);
+  next_tone = hal_millis() + t->duration + (uint16_t)t->gap;
 
 }
 
-void RoboBrrd::rightWingGust() {
 
-	uint8_t gust = 0;
 
-	if(rwing_pos[2] < rwing_pos[0]) {
-		gust = rwing_pos[2] + 20;
-	} else {
-		gust = rwing_pos[2] - 20;
-	}
+/**
+ * Melodies
+ */
 
-	for(uint8_t i=0; i<3; i++) {
-		servoMove(RWING_SERVO, rwing_pos[2], 50);
-		servoMove(RWING_SERVO, gust, 50);
-	}
+// each melody is a list of notes that the sequencer feeds to the speaker,
+// see the MELODY_NOTE macros in RoboBrrd.h for the format.
 
-	servoMove(RWING_SERVO, rwing_pos[0], 80);
+static const uint8_t melody_robotgrrl[] PROGMEM = {
+	MELODY_TEMPO(10),
+	MELODY_NOTE(94, 7),
+	MELODY_NOTE(93, 7),
+	MELODY_NOTE(92, 7),
+	MELODY_REST(10),
+	MELODY_REPEAT(4),
+	MELODY_END
+};
 
-}
+static const uint8_t melody_chirp[] PROGMEM = {
+	MELODY_TEMPO(10),
+	MELODY_NOTE(96, 3),
+	MELODY_NOTE(100, 3),
+	MELODY_NOTE(103, 4),
+	MELODY_END
+};
 
-void RoboBrrd::rightWingPos(uint8_t pos) {
-	servoMove(RWING_SERVO, pos, 80);
-}
+static const uint8_t melody_question[] PROGMEM = {
+	MELODY_TEMPO(10),
+	MELODY_NOTE(88, 8),
+	MELODY_REST(4),
+	MELODY_NOTE(91, 6),
+	MELODY_NOTE(95, 12),
+	MELODY_END
+};
 
+static const uint8_t melody_happy[] PROGMEM = {
+	MELODY_TEMPO(60),
+	MELODY_NOTE(84, 1),
+	MELODY_NOTE(88, 1),
+	MELODY_NOTE(91, 1),
+	MELODY_NOTE(96, 3),
+	MELODY_END
+};
 
+static const uint8_t melody_sad[] PROGMEM = {
+	MELODY_TEMPO(100),
+	MELODY_NOTE(79, 2),
+	MELODY_NOTE(78, 2),
+	MELODY_NOTE(77, 2),
+	MELODY_NOTE(76, 6),
+	MELODY_END
+};
 
-// -- left wing
+static const uint8_t melody_alarm[] PROGMEM = {
+	MELODY_TEMPO(50),
+	MELODY_NOTE(93, 4),
+	MELODY_NOTE(89, 4),
+	MELODY_REPEAT(MELODY_FOREVER),
+	MELODY_END
+};
 
-void RoboBrrd::leftWingUp() {
-	servoMove(LWING_SERVO, lwing_pos[1], 50);
-}
 
-void RoboBrrd::leftWingDown() {
-	servoMove(LWING_SERVO, lwing_pos[2], 50);
-}
+// in the same order as the Melody enum
+static const uint8_t * const melody_tables[] PROGMEM = {
+	melody_robotgrrl,
+	melody_chirp,
+	melody_question,
+	melody_happy,
+	melody_sad,
+	melody_alarm
+};
 
-void RoboBrrd::leftWingHome() {
-	servoMove(LWING_SERVO, lwing_pos[0], 50);
-}
 
-void RoboBrrd::leftWingWave() {
+// -- half periods in us of the lowest octave, midi notes 0-11. every
+// octave up is half of that
+static const uint16_t note_half_periods[12] PROGMEM = {
+	61156, 57724, 54484, 51426, 48540, 45815,
+	43244, 40817, 38526, 36364, 34323, 32396
+};
 
-	for(uint8_t i=0; i<3; i++) {
-		servoMove(LWING_SERVO, lwing_pos[1], 150);
-		servoMove(LWING_SERVO, lwing_pos[2], 150);
-	}
 
-	servoMove(LWING_SERVO, lwing_pos[0], 80);
+void RoboBrrd::playMelody(uint8_t id) {
+
+	if(id >= NUM_MELODIES) return;
+
+	playMelodyTable((const uint8_t *)pgm_read_ptr(&melody_tables[id]));
 
 }
 
-void RoboBrrd::leftWingGust() {
 
-	uint8_t gust = 0;
+// -- starts over anything that was playing
+void RoboBrrd::playMelodyTable(const uint8_t *melody) {
 
-	if(lwing_pos[2] < lwing_pos[0]) {
-		gust = lwing_pos[2] + 20;
-	} else {
-		gust = lwing_pos[2] - 20;
-	}
+	stopTone();
 
-	for(uint8_t i=0; i<3; i++) {
-		servoMove(LWING_SERVO, lwing_pos[2], 50);
-		servoMove(LWING_SERVO, gust, 50);
-	}
+	melody_unit = pgm_read_byte(melody);
+	melody_pc = 0;
+	melody_looping = false;
+	melody_loops_left = 0;
+	melody_ptr = melody;
 
-	servoMove(LWING_SERVO, lwing_pos[0], 80);
+	updateMelody();
 
 }
 
-void RoboBrrd::leftWingPos(uint8_t pos) {
-	servoMove(LWING_SERVO, pos, 80);
+
+void RoboBrrd::stopMelody() {
+	stopTone();
 }
 
 
+// -- called from update(), keeps the next note waiting in the tone queue
+// behind the one that's playing, so there's no gap between them
+void RoboBrrd::updateMelody() {
 
-// -- wings
+	while(melody_ptr != NULL && tone_count < 2) {
 
-void RoboBrrd::bothWingsUp(bool up) {
+		// +1 for the tempo at the start
+		const uint8_t *step = melody_ptr + 1 + (melody_pc * 2);
+		uint8_t note = pgm_read_byte(step);
+		uint8_t len = pgm_read_byte(step+1);
 
-	if(auto_detach) {
-		servoAttach(RWING_SERVO);
-		servoAttach(LWING_SERVO);
-	}
+		if(note == MELODY_OP_END) {
+			melody_ptr = NULL;
+			return;
+		}
 
-	if(up) {
+		if(note == MELODY_OP_REPEAT) {
 
-		servo[RWING_SERVO].write(rwing_pos[1]);
-		servo[LWING_SERVO].write(lwing_pos[1]);
-		delay(150);
+			if(!melody_looping) {
+				melody_looping = true;
+				melody_loops_left = len;
+			}
 
-		last_servo_pos[RWING_SERVO] = rwing_pos[1];
-		last_servo_pos[LWING_SERVO] = lwing_pos[1];
+			if(melody_loops_left > 0) {
+				if(melody_loops_left != MELODY_FOREVER) melody_loops_left--;
+				melody_pc = 0;
+			} else {
+				melody_looping = false;
+				melody_pc++;
+			}
 
-	} else {
+			continue;
 
-		servo[RWING_SERVO].write(rwing_pos[2]);
-		servo[LWING_SERVO].write(lwing_pos[2]);
-		delay(150);
+		}
 
-		last_servo_pos[RWING_SERVO] = rwing_pos[2];
-		last_servo_pos[LWING_SERVO] = lwing_pos[2];
+		uint16_t duration = (uint16_t)len * melody_unit;
+		melody_pc++;
 
-	}
+		if(note == MELODY_OP_REST) {
+			enqueueTone(0, duration, 0);
+		} else {
+			enqueueTone(noteHalfPeriod(note), duration, 0);
+		}
 
-	if(auto_detach) {
-		servoDetach(RWING_SERVO);
-		servoDetach(LWING_SERVO);
 	}
 
-	last_servo_move[RWING_SERVO] = millis();
-	last_servo_move[LWING_SERVO] = millis();
+}
 
-	for(uint8_t i=0; i<5; i++) {
-		last_servos_moved[i+1] = last_servos_moved[i];
-	}
 
-	last_servos_moved[0] = RWING_SERVO;
+uint16_t RoboBrrd::noteHalfPeriod(uint8_t note) {
 
-	for(uint8_t i=0; i<5; i++) {
-		last_servos_moved[i+1] = last_servos_moved[i];
-	}
+	if(note > 127) return 0;
+
+	uint8_t octave = note / 12;
+	uint16_t t = pgm_read_word(&note_half_periods[note % 12]);
 
-	last_servos_moved[0] = LWING_SERVO;
+	// -- rounded, not just shifted
+	if(octave == 0) return t;
+	return ((uint32_t)t + (1UL << (octave-1))) >> octave;
 
 }
 
 
-void RoboBrrd::bothWingWave(bool opposite) {
 
-	if(auto_detach) {
-		servoAttach(RWING_SERVO);
-		servoAttach(LWING_SERVO);
-	}
+/**
+ * Movements
+ */
 
-	if(!opposite) {
+// -- beak
 
-		for(uint8_t i=0; i<4; i++) {
-			servo[RWING_SERVO].write(rwing_pos[1]);
-			servo[LWING_SERVO].write(lwing_pos[1]);
-			delay(150);
-			servo[RWING_SERVO].write(rwing_pos[2]);
-			servo[LWING_SERVO].write(lwing_pos[2]);
-			delay(150);	
-		}
+void RoboBrrd::beakOpen() {
+	playGesture(GESTURE_BEAK_OPEN);
+}
 
-	} else {
+void RoboBrrd::beakClose() {
+	playGesture(GESTURE_BEAK_CLOSE);
+}
 
-		for(uint8_t i=0; i<4; i++) {
-			servo[RWING_SERVO].write(rwing_pos[1]);
-			servo[LWING_SERVO].write(lwing_pos[2]);
-			delay(150);
-			servo[RWING_SERVO].write(rwing_pos[2]);
-			servo[LWING_SERVO].write(lwing_pos[1]);
-			delay(150);	
-		}
+void RoboBrrd::beakHome() {
+	playGesture(GESTURE_BEAK_HOME);
+}
 
-	}
+void RoboBrrd::beakSnip() {
+	playGesture(GESTURE_BEAK_SNIP);
+}
 
-	servo[RWING_SERVO].write(rwing_pos[0]);
-	servo[LWING_SERVO].write(lwing_pos[0]);
-	delay(80);
+void RoboBrrd::beakLaugh() {
+	playGesture(GESTURE_BEAK_LAUGH);
+}
 
-	if(auto_detach) {
-		servoDetach(RWING_SERVO);
-		servoDetach(LWING_SERVO);
-	}
+void RoboBrrd::beakPos(uint8_t pos) {
+	servoMove(BEAK_SERVO, pos, 100);
+}
 
-	last_servo_move[RWING_SERVO] = millis();
-	last_servo_move[LWING_SERVO] = millis();
 
-	last_servo_pos[RWING_SERVO] = rwing_pos[0];
-	last_servo_pos[LWING_SERVO] = lwing_pos[0];
 
-	for(uint8_t i=0; i<5; i++) {
-		last_servos_moved[i+1] = last_servos_moved[i];
-	}
+// -- rotation
 
-	last_servos_moved[0] = RWING_SERVO;
+void RoboBrrd::rotateLeft() {
+	playGesture(GESTURE_ROTATE_LEFT);
+}
 
-	for(uint8_t i=0; i<5; i++) {
-		last_servos_moved[i+1] = last_servos_moved[i];
-	}
+void RoboBrrd::rotateRight() {
+	playGesture(GESTURE_ROTATE_RIGHT);
+}
 
-	last_servos_moved[0] = LWING_SERVO;
+void RoboBrrd::rotateHome() {
+	playGesture(GESTURE_ROTATE_HOME);
+}
 
+void RoboBrrd::shakeShake() {
+	playGesture(GESTURE_SHAKE_SHAKE);
 }
 
+void RoboBrrd::rotateBounce() {
+	playGesture(GESTURE_ROTATE_BOUNCE);
+}
 
-void RoboBrrd::bothWingGust(bool opposite) {
+void RoboBrrd::rotatePos(uint8_t pos) {
+	servoMove(ROTATION_SERVO, pos, 100);	
+}
 
-	if(auto_detach) {
-		servoAttach(RWING_SERVO);
-		servoAttach(LWING_SERVO);
-	}
 
-	uint8_t gust_l = 0;
-	uint8_t gust_r = 0;
 
-	if(lwing_pos[2] < lwing_pos[0]) {
-		gust_l = lwing_pos[2] + 20;
-	} else {
-		gust_l = lwing_pos[2] - 20;
-	}
+// -- right wing
 
-	if(rwing_pos[2] < rwing_pos[0]) {
-		gust_r = rwing_pos[2] + 20;
-	} else {
-		gust_r = rwing_pos[2] - 20;
-	}		
+void RoboBrrd::rightWingUp() {
+	playGesture(GESTURE_RWING_UP);
+}
 
-	if(!opposite) {
+void RoboBrrd::rightWingDown() {
+	playGesture(GESTURE_RWING_DOWN);
+}
 
-		for(uint8_t i=0; i<3; i++) {
-			servo[LWING_SERVO].write(lwing_pos[2]);
-			servo[RWING_SERVO].write(rwing_pos[2]);
-			delay(50);
+void RoboBrrd::rightWingHome() {
+	playGesture(GESTURE_RWING_HOME);
+}
 
-			servo[LWING_SERVO].write(gust_l);
-			servo[RWING_SERVO].write(gust_r);
-			delay(50);
-		}
+void RoboBrrd::rightWingWave() {
+	playGesture(GESTURE_RWING_WAVE);
+}
 
-	} else {
+void RoboBrrd::rightWingGust() {
+	playGesture(GESTURE_RWING_GUST);
+}
 
-		for(uint8_t i=0; i<3; i++) {
-			servo[LWING_SERVO].write(lwing_pos[2]);
-			servo[RWING_SERVO].write(gust_r);
-			delay(50);
+void RoboBrrd::rightWingPos(uint8_t pos) {
+	servoMove(RWING_SERVO, pos, 80);
+}
 
-			servo[LWING_SERVO].write(gust_l);
-			servo[RWING_SERVO].write(rwing_pos[2]);
-			delay(50);
-		}
 
-	}
 
-	servo[RWING_SERVO].write(rwing_pos[0]);
-	servo[LWING_SERVO].write(lwing_pos[0]);
-	delay(80);
+// -- left wing
 
-	if(auto_detach) {
-		servoDetach(RWING_SERVO);
-		servoDetach(LWING_SERVO);
-	}
+void RoboBrrd::leftWingUp() {
+	playGesture(GESTURE_LWING_UP);
+}
 
-	last_servo_move[RWING_SERVO] = millis();
-	last_servo_move[LWING_SERVO] = millis();
+void RoboBrrd::leftWingDown() {
+	playGesture(GESTURE_LWING_DOWN);
+}
 
-	last_servo_pos[RWING_SERVO] = rwing_pos[0];
-	last_servo_pos[LWING_SERVO] = lwing_pos[0];
+void RoboBrrd::leftWingHome() {
+	playGesture(GESTURE_LWING_HOME);
+}
 
-	for(uint8_t i=0; i<5; i++) {
-		last_servos_moved[i+1] = last_servos_moved[i];
-	}
+void RoboBrrd::leftWingWave() {
+	playGesture(GESTURE_LWING_WAVE);
+}
 
-	last_servos_moved[0] = RWING_SERVO;
+void RoboBrrd::leftWingGust() {
+	playGesture(GESTURE_LWING_GUST);
+}
 
-	for(uint8_t i=0; i<5; i++) {
-		last_servos_moved[i+1] = last_servos_moved[i];
-	}
+void RoboBrrd::leftWingPos(uint8_t pos) {
+	servoMove(LWING_SERVO, pos, 80);
+}
+
+
+
+// -- wings
+
+void RoboBrrd::bothWingsUp(bool up) {
+	playGesture(up ? GESTURE_WINGS_UP : GESTURE_WINGS_DOWN);
+}
 
-	last_servos_moved[0] = LWING_SERVO;
+void RoboBrrd::bothWingWave(bool opposite) {
+	playGesture(opposite ? GESTURE_WINGS_WAVE_OPPOSITE : GESTURE_WINGS_WAVE);
+}
 
+void RoboBrrd::bothWingGust(bool opposite) {
+	playGesture(opposite ? GESTURE_WINGS_GUST_OPPOSITE : GESTURE_WINGS_GUST);
 }
 
 
@@ -1312,7 +3175,7 @@ void RoboBrrd::bothWingGust(bool opposite) {
  */
 
 bool RoboBrrd::isMemInit() {
-	bool mem = EEPROM.read(init_addr);
+	bool mem = hal_eepromRead(init_addr);
 	return mem;
 }
 
@@ -1417,19 +3280,19 @@ void RoboBrrd::parse_action(uint8_t stream, char action, char cmd, uint8_t key,
 			switch(cmd) {
 				
 				case 'S': // rotation
-					servoMove(ROTATION_SERVO, val, key*10);
+					enqueueWaypoint(ROTATION_SERVO, val, key*10);
 				break;
 				
 				case 'B': // beak
-					servoMove(BEAK_SERVO, val, key*10);
+					enqueueWaypoint(BEAK_SERVO, val, key*10);
 				break;
 				
 				case 'R': // right wing
-					servoMove(RWING_SERVO, val, key*10);
+					enqueueWaypoint(RWING_SERVO, val, key*10);
 				break;
 				
 				case 'L': // left wing
-					servoMove(LWING_SERVO, val, key*10);
+					enqueueWaypoint(LWING_SERVO, val, key*10);
 				break;
 				
 				case 'E': // eye (rgb led)
@@ -1446,18 +3309,53 @@ void RoboBrrd::parse_action(uint8_t stream, char action, char cmd, uint8_t key,
 				
 				case 'F': // eye (hsi)
 
+					// hue in degrees, saturation and intensity in %
+					updateEyesHSI();
+					if(val > 100 && key != 0) val = 100;
+
 					if(key == 0) {
-						setEyesHSI(val, current_hsi[1], current_hsi[2]);
+						eye_anim = EYES_STILL;
+						showEyesHSI(((uint32_t)val * 8) % HSI_HUE_STEPS, current_sat, current_int);
 					} else if(key == 1) {
-						setEyesHSI(current_hsi[0], (float)(val)/100.0, current_hsi[2]);
+						eye_anim = EYES_STILL;
+						showEyesHSI(current_hue, (val * 255 + 50) / 100, current_int);
 					} else if(key == 2) {
-						setEyesHSI(current_hsi[0], current_hsi[1], (float)(val)/100.0);
+						eye_anim = EYES_STILL;
+						showEyesHSI(current_hue, current_sat, (val * 255 + 50) / 100);
 					}
 
 				break;
 				
 				case 'P': // piezo / speaker
-					playTone(val, key*10);
+					if(val == 0) {
+						stopTone();
+					} else {
+						playTone(val, key*10);
+					}
+				break;
+
+				case 'M': // melody
+
+					if(key == 0) { // 0 = stop
+						stopMelody();
+					} else if(key == 1) { // 1 = play
+						playMelody(val);
+					} else if(key == 2) { // 2 = is one playing
+						transmit_message(stream, '#', 'M', 0, isMelodyPlaying() ? 1 : 0, '!');
+					}
+
+				break;
+
+				case 'K': // light sensor calibration
+
+					if(key == 0) { // 0 = get (0 calibrating, 1 calibrated, 2 timed out, 3 using the saved one)
+						transmit_message(stream, '#', 'K', 0, getLightCalibration(), '!');
+					} else if(key == 1) { // 1 = start again
+						recalibrateLightSensors();
+					} else if(key == 2) { // 2 = forget the saved one
+						forgetLightCalibration();
+					}
+
 				break;
 
 				case 'I': // left ldr
@@ -1517,6 +3415,22 @@ void RoboBrrd::parse_action(uint8_t stream, char action, char cmd, uint8_t key,
 					}
 
 				break;
+
+				case 'Q': // motion queue
+
+					if(key == 0) { // 0 = depth
+						transmit_message(stream, '#', 'Q', 0, getMotionQueueDepth(), '!');
+					} else if(key == 1) { // 1 = overflows
+						transmit_message(stream, '#', 'Q', 1, getMotionQueueOverflows(), '!');
+					} else if(key == 2) { // 2 = preemptions
+						transmit_message(stream, '#', 'Q', 2, getMotionPreemptions(), '!');
+					} else if(key == 3) { // 3 = servo writes
+						transmit_message(stream, '#', 'Q', 3, getServoWrites(), '!');
+					} else if(key == 4) { // 4 = servo writes dropped
+						transmit_message(stream, '#', 'Q', 4, getServoWritesSuppressed(), '!');
+					}
+
+				break;
 			}
 
 		break;
@@ -1524,132 +3438,99 @@ void RoboBrrd::parse_action(uint8_t stream, char action, char cmd, uint8_t key,
 
 		case '#': { // movements
 
-			switch(cmd) {
+			// movements are queued and played by update(), so that this
+			// returns right away. going home is high priority, so it cuts
+			// off whatever is playing at the moment.
 
-				case 'S': // rotation
+			uint8_t base = 0;
+			uint8_t ser = 0;
+			uint16_t del = 100;
 
-					switch(key) {
-						case 0:
-							rotateLeft();
-						break;
-						case 1:
-							rotateRight();
-						break;
-						case 2:
-							rotateHome();
-						break;
-						case 3:
-							shakeShake();
-						break;
-						case 4:
-							rotateBounce();
-						break;
-						case 5:
-							rotatePos( check8Bit(val) );
-						break;
-					}
+			switch(cmd) {
 
+				case 'S': // rotation
+					base = GESTURE_ROTATE_LEFT;
+					ser = ROTATION_SERVO;
 				break;
 
 				case 'B': // beak
+					base = GESTURE_BEAK_OPEN;
+					ser = BEAK_SERVO;
+				break;
 
-					switch(key) {
-						case 0:
-							beakOpen();
-						break;
-						case 1:
-							beakClose();
-						break;
-						case 2:
-							beakHome();
-						break;
-						case 3:
-							beakSnip();
-						break;
-						case 4:
-							beakLaugh();
-						break;
-						case 5:
-							beakPos( check8Bit(val) );
-						break;
-					}
+				case 'R': // right wing
+					base = GESTURE_RWING_UP;
+					ser = RWING_SERVO;
+					del = 80;
+				break;
 
+				case 'L': // left wing
+					base = GESTURE_LWING_UP;
+					ser = LWING_SERVO;
+					del = 80;
 				break;
 
-				case 'R': // right wing
+				case 'O': // extra extra!
 
 					switch(key) {
 						case 0:
-							rightWingUp();
+							if(isMoving()) motion_preemptions++;
+							stopMotion();
+							servosDetach();
 						break;
 						case 1:
-							rightWingDown();
+							if(val == 0) {
+								enqueueGesture(GESTURE_WINGS_WAVE, MOTION_NORMAL);
+							} else if(val == 1) {
+								enqueueGesture(GESTURE_WINGS_WAVE_OPPOSITE, MOTION_NORMAL);
+							}
 						break;
 						case 2:
-							rightWingHome();
-						break;
-						case 3:
-							rightWingWave();
-						break;
-						case 4:
-							rightWingGust();
-						break;
-						case 5:
-							rightWingPos( check8Bit(val) );
+							if(val == 0) {
+								enqueueGesture(GESTURE_WINGS_GUST, MOTION_NORMAL);
+							} else if(val == 1) {
+								enqueueGesture(GESTURE_WINGS_GUST_OPPOSITE, MOTION_NORMAL);
+							}
 						break;
 					}
 
-				break;
+				return;
 
-				case 'L': // left wing
+				case 'C': // choreography control
+
+					choreo_stream = stream;
 
 					switch(key) {
 						case 0:
-							leftWingUp();
+							startChoreo();
 						break;
 						case 1:
-							leftWingDown();
+							stopChoreo();
 						break;
 						case 2:
-							leftWingHome();
-						break;
-						case 3:
-							leftWingWave();
-						break;
-						case 4:
-							leftWingGust();
-						break;
-						case 5:
-							leftWingPos( check8Bit(val) );
+							commitChoreoChunk();
 						break;
 					}
 
-				break;
+				return;
 
-				case 'O': // extra extra!
+				case 'D': // choreography step
+					choreo_stream = stream;
+					addChoreoStep(key, val);
+				return;
 
-					switch(key) {
-						case 0:
-							servosDetach();
-						break;
-						case 1:
-							if(val == 0) {
-								bothWingWave(false);
-							} else if(val == 1) {
-								bothWingWave(true);
-							}
-						break;
-						case 2:
-							if(val == 0) {
-								bothWingGust(false);
-							} else if(val == 1) {
-								bothWingGust(true);
-							}
-						break;
-					}
+				default:
+				return;
 
-				break;
+			}
 
+			// keys 0-4 line up with the gestures for each servo, and 2 is home
+			if(key == 2) {
+				enqueueGesture(base + key, MOTION_HIGH);
+			} else if(key < 5) {
+				enqueueGesture(base + key, MOTION_NORMAL);
+			} else if(key == 5) {
+				enqueueWaypoint(ser, check8Bit(val), del);
 			}
 
 		break;
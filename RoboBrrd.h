@@ -33,6 +33,15 @@
    void ldr_right_dark()
 
    void ldr_right_bright()
+
+   (and if you want them, these are optional)
+
+   void ldr_left_normal()
+
+   void ldr_right_normal()
+
+   (any other channels, see ROBOBRRD_LDRS, use setLdrDarkHandler(ch, ...)
+   and friends)
  
  *
  * API
@@ -66,19 +75,87 @@
 #ifndef _ROBOBRRD_H_
 #define _ROBOBRRD_H_
 
-#include <Servo.h>
-#include <EEPROM.h>
+#include "RoboBrrdHal.h"
 
 #include "Streaming.h"
 #include "Promulgate.h"
 #include "MemoryMap.h"
 
-#if ARDUINO >= 100
-	#include "Arduino.h"
-#else
-	#include "WProgram.h"
+
+// -- gestures
+// A gesture is a PROGMEM list of 3 byte steps: servo and target, an
+// offset (towards home) from that target, and the time in ms to wait
+// before the next step (in 10ms units, so up to 2550ms). A step with
+// no time starts together with the step after it. For example:
+//
+//   const uint8_t my_wave[] PROGMEM = {
+//     GESTURE_MOVE(RoboBrrd::RWING_SERVO, GESTURE_P2, 0, 150),
+//     GESTURE_MOVE(RoboBrrd::RWING_SERVO, GESTURE_P3, 10, 150),
+//     GESTURE_REPEAT(2, 3), // go back 2 steps, 3 more times
+//     GESTURE_END
+//   };
+//
+//   robobrrd.playGestureTable(my_wave);
+
+#define GESTURE_HOME 0
+#define GESTURE_P2 1
+#define GESTURE_P3 2
+
+#define GESTURE_OP_REPEAT 0x80
+#define GESTURE_OP_END 0xFF
+
+#define GESTURE_MOVE(ser, target, offset, del) (uint8_t)(((target)<<4) | (ser)), (uint8_t)(offset), (uint8_t)((del)/10)
+#define GESTURE_REPEAT(steps, times) GESTURE_OP_REPEAT, (uint8_t)(steps), (uint8_t)(times)
+#define GESTURE_END GESTURE_OP_END, 0, 0
+
+
+// -- melodies
+// A melody is a PROGMEM list of bytes for the speaker. It starts with the
+// tempo (how long one unit is, in ms), then 2 byte notes: a MIDI note
+// number (69 is the A at 440Hz) and how many units it lasts. For example:
+//
+//   const uint8_t my_chirp[] PROGMEM = {
+//     MELODY_TEMPO(10),
+//     MELODY_NOTE(96, 5),   // C7 for 50ms
+//     MELODY_NOTE(100, 5),
+//     MELODY_REST(20),
+//     MELODY_REPEAT(2),     // from the top, 2 more times
+//     MELODY_END
+//   };
+//
+//   robobrrd.playMelodyTable(my_chirp);
+
+#define MELODY_FOREVER 0xFF
+
+#define MELODY_OP_REST 0x80
+#define MELODY_OP_REPEAT 0x81
+#define MELODY_OP_END 0xFF
+
+#define MELODY_TEMPO(ms) (uint8_t)(ms)
+#define MELODY_NOTE(note, len) (uint8_t)(note), (uint8_t)(len)
+#define MELODY_REST(len) MELODY_OP_REST, (uint8_t)(len)
+#define MELODY_REPEAT(times) MELODY_OP_REPEAT, (uint8_t)(times)
+#define MELODY_END MELODY_OP_END, 0
+
+
+// -- light sensors
+// Each light sensor is a channel, and all of the channels are sampled,
+// averaged and triggered in the same loop. Channel 0 is the left one (on
+// A0) and 1 is the right one (on A1). Anything else analog that should
+// set off a handler when it goes up or down (a third light sensor, a mic
+// level, a pot) can be another channel, on A2 and A3 or wherever
+// setLdrPin() says. The library is compiled on its own, so change this
+// here (or for the whole build), not in the sketch.
+
+#ifndef ROBOBRRD_LDRS
+	#define ROBOBRRD_LDRS 2
 #endif
 
+#if ROBOBRRD_LDRS < 1 || ROBOBRRD_LDRS > HAL_ADC_PINS
+	#error "RoboBrrd can have 1 to HAL_ADC_PINS light sensors"
+#endif
+
+
 class RoboBrrd {
 	
 
@@ -99,8 +176,9 @@ class RoboBrrd {
 		void setGreenLedPin(uint8_t pin) { led_pins[1] = pin; };
 		void setBlueLedPin(uint8_t pin) { led_pins[2] = pin; };
 		void setSpkrPin(uint8_t pin) { spkr_pin = pin; };
-		void setLdrLeftPin(uint8_t pin) { ldr_left_pin = pin; };
-		void setLdrRightPin(uint8_t pin) { ldr_right_pin = pin; };
+		void setLdrPin(uint8_t ch, uint8_t pin) { if(ch < NUM_LDRS) ldr_pins[ch] = pin; };
+		void setLdrLeftPin(uint8_t pin) { setLdrPin(LDR_LEFT, pin); };
+		void setLdrRightPin(uint8_t pin) { setLdrPin(LDR_RIGHT, pin); };
 
 
 
@@ -112,7 +190,19 @@ class RoboBrrd {
     	LWING_SERVO
     };
 
+    // -- servo power: a servo is active while moving, then holds its
+    // position, then (with auto detach) is detached after its hold time
+    enum ServoPower {
+      SERVO_DETACHED,
+      SERVO_ACTIVE,
+      SERVO_HOLDING
+    };
+
     void setAutoDetach(bool tf);
+    void setServoHoldTime(uint8_t ser, uint16_t ms);
+    uint8_t getServoPower(uint8_t ser) { return servo_power[ser]; }
+    uint16_t getServoAttaches(uint8_t ser) { return servo_attaches[ser]; }
+    uint16_t getServoDetaches(uint8_t ser) { return servo_detaches[ser]; }
 		void setServoHome(uint8_t ser, uint16_t pos);
 		void setServoDefaults(uint8_t ser, uint16_t p1, uint16_t p2, uint16_t p3);
 		void setServoDefaultP2(uint8_t ser, uint16_t pos);
@@ -125,39 +215,179 @@ class RoboBrrd {
     void servoDetach(uint8_t ser);
     void servosHome();
 		void servoMove(uint8_t ser, uint8_t pos, uint16_t del);
+
+		// -- motion scheduler (when async, moves are queued and played by update)
+		void setAsyncMotion(bool tf) { async_motion = tf; }
+		bool isAsyncMotion() { return async_motion; }
+		bool isMoving();
+		void stopMotion();
+		uint8_t getMotionQueueDepth();
+		uint16_t getMotionQueueOverflows() { return motion_overflows; }
+		uint16_t getMotionPreemptions() { return motion_preemptions; }
+		void setMotionCompleteHandler( void(*function)() ) { motionComplete = function; }
+
+		// -- gestures (all of the built-in movements below are gestures)
+		enum Gesture {
+			GESTURE_BEAK_OPEN,
+			GESTURE_BEAK_CLOSE,
+			GESTURE_BEAK_HOME,
+			GESTURE_BEAK_SNIP,
+			GESTURE_BEAK_LAUGH,
+			GESTURE_ROTATE_LEFT,
+			GESTURE_ROTATE_RIGHT,
+			GESTURE_ROTATE_HOME,
+			GESTURE_SHAKE_SHAKE,
+			GESTURE_ROTATE_BOUNCE,
+			GESTURE_RWING_UP,
+			GESTURE_RWING_DOWN,
+			GESTURE_RWING_HOME,
+			GESTURE_RWING_WAVE,
+			GESTURE_RWING_GUST,
+			GESTURE_LWING_UP,
+			GESTURE_LWING_DOWN,
+			GESTURE_LWING_HOME,
+			GESTURE_LWING_WAVE,
+			GESTURE_LWING_GUST,
+			GESTURE_WINGS_UP,
+			GESTURE_WINGS_DOWN,
+			GESTURE_WINGS_WAVE,
+			GESTURE_WINGS_WAVE_OPPOSITE,
+			GESTURE_WINGS_GUST,
+			GESTURE_WINGS_GUST_OPPOSITE,
+			NUM_GESTURES
+		};
+
+		void playGesture(uint8_t id);
+		void playGestureTable(const uint8_t *gesture);
+
+		// -- keyframes (the servos in the mask all arrive together after duration ms)
+		enum KeyframeMask {
+			KEYFRAME_ROTATION = 0x01,
+			KEYFRAME_BEAK = 0x02,
+			KEYFRAME_RWING = 0x04,
+			KEYFRAME_LWING = 0x08,
+			KEYFRAME_ALL = 0x0F
+		};
+
+		void keyframe(uint8_t mask, uint8_t rot, uint8_t beak, uint8_t rwing, uint8_t lwing, uint16_t duration);
+
+		// -- choreography (gestures streamed in chunks, see Serial_API_Info.h)
+		void startChoreo();
+		void stopChoreo();
+		bool addChoreoStep(uint8_t move, uint16_t wait);
+		void commitChoreoChunk();
+		bool isChoreoPlaying() { return choreo_playing; }
+		uint16_t getChoreoStarved() { return choreo_starved; }
+		uint16_t getChoreoDropped() { return choreo_dropped; }
+
+		// -- trajectories (speed in deg/s, accel in deg/s^2, 0 = jump to the position)
+		void setServoSpeed(uint8_t ser, uint16_t max_speed, uint16_t max_accel);
+		bool isServoSettled(uint8_t ser) { return !(traj_active_mask & (1<<ser)); }
+		uint16_t getServoWrites() { return servo_writes; }
+		uint16_t getServoWritesSuppressed() { return servo_writes_suppressed; }
 		
 
 	
 		// -- leds
-		float current_hsi[3];
-		uint8_t current_rgb[3];
-
-		void setMaxBrightness(float b) { MAX_BRIGHTNESS = b; }
+		void setMaxBrightness(float b);
+		void setEyesGamma(bool tf); // on by default so fades look even, off for the old (linear) colours
+		void setEyesDither(bool tf); // off by default, smoother dim colours
 
 		void ledsDefault();
 		void saveLedsDefault();
 		void setEyesRGB(uint8_t r, uint8_t g, uint8_t b);
     void setEyesHSI(float H, float S, float I);
+    void setEyesRGB12(uint16_t r, uint16_t g, uint16_t b);
+    void getEyesRGB(uint8_t *rgb);
+    void getEyesHSI(float *hsi);
+
+    // -- eye animations, these run in update() and never block.
+    // setEyesRGB and setEyesHSI stop them
+    void fadeEyesRGB(uint8_t r, uint8_t g, uint8_t b, uint16_t duration);
+    void fadeEyesHSI(float H, float S, float I, uint16_t duration);
+    void blinkEyes(uint16_t on_ms, uint16_t off_ms, float dim, uint8_t times);
+    void breatheEyes(uint16_t period, float low);
+    void cycleEyesHue(uint16_t period);
+    void stopEyes();
+    bool isEyesAnimating() { return eye_anim != EYES_STILL; }
+
+    // -- integer hsi to rgb: H in 1/8 degrees (0-2879), S and I 0-255
+    static const uint16_t HSI_HUE_STEPS = 360*8;
+    static void hsi2rgb(uint16_t H, uint8_t S, uint8_t I, uint8_t *rgb);
+    static void rgb2hsi(uint8_t r, uint8_t g, uint8_t b, uint16_t *H, uint8_t *S, uint8_t *I);
   
 
 
     // -- sensors
     void enableLightSensors(bool tf) { light_sensors_enabled = tf; }
 
-    uint16_t getLeftLDR() { return current_ldr_left_val; }
-		uint16_t getRightLDR() { return current_ldr_right_val; }
+    // -- the adc reads the light sensors in the background instead, about
+    // every 2ms each, and each sample is the average of those readings
+    void enableBackgroundADC(bool tf);
+    uint16_t getADCOverflows() { return hal_adcOverflows(); }
+
+    // -- calibration happens in the background during update(), and the
+    // handlers aren't called until there's a baseline to compare with
+    enum LightCalibration {
+      LIGHT_CALIBRATING,
+      LIGHT_CALIBRATED,
+      LIGHT_TIMED_OUT, // the light never settled, so the baseline is just the average
+      LIGHT_SAVED // using the baseline saved in eeprom, while it calibrates
+    };
+
+    // -- the light sensors are sampled every fast ms while the light is
+    // changing, backing off to every slow ms when it's steady
+    void setLightSampleTime(uint16_t fast, uint16_t slow);
+    uint16_t getLightSampleTime() { return sample_time; }
+
+    uint8_t getLightCalibration() { return light_calibration; }
+    void recalibrateLightSensors();
+
+    // -- the baseline is saved once calibrated (and every so often after
+    // that), and loaded at init() so the handlers work straight away
+    void saveLightCalibration();
+    bool loadLightCalibration();
+    void forgetLightCalibration();
 
-    void setLdrLeftDarkHandler( void(*function)() ) { ldrLeftDark = function; }
-    void setLdrLeftBrightHandler( void(*function)() ) { ldrLeftBright = function; }
-    void setLdrRightDarkHandler( void(*function)() ) { ldrRightDark = function; }
-    void setLdrRightBrightHandler( void(*function)() ) { ldrRightBright = function; }
+    // -- the channels (see ROBOBRRD_LDRS)
+    static const uint8_t NUM_LDRS = ROBOBRRD_LDRS;
+
+    enum LdrChannel {
+      LDR_LEFT,
+      LDR_RIGHT
+    };
+
+    uint16_t getLDR(uint8_t ch) { return (ch < NUM_LDRS) ? current_ldr_val[ch] : 0; }
+    uint16_t getLeftLDR() { return getLDR(LDR_LEFT); }
+		uint16_t getRightLDR() { return getLDR(LDR_RIGHT); }
+
+    // -- the handlers are called once when the sensor goes dark, bright or
+    // back to normal, not the whole time it stays that way
+    enum LdrState {
+      LDR_NORMAL,
+      LDR_DARK,
+      LDR_BRIGHT
+    };
+
+    void setLdrDarkHandler(uint8_t ch, void(*function)() ) { if(ch < NUM_LDRS) ldrDark[ch] = function; }
+    void setLdrBrightHandler(uint8_t ch, void(*function)() ) { if(ch < NUM_LDRS) ldrBright[ch] = function; }
+    void setLdrNormalHandler(uint8_t ch, void(*function)() ) { if(ch < NUM_LDRS) ldrNormal[ch] = function; }
+
+    void setLdrLeftDarkHandler( void(*function)() ) { setLdrDarkHandler(LDR_LEFT, function); }
+    void setLdrLeftBrightHandler( void(*function)() ) { setLdrBrightHandler(LDR_LEFT, function); }
+    void setLdrLeftNormalHandler( void(*function)() ) { setLdrNormalHandler(LDR_LEFT, function); }
+    void setLdrRightDarkHandler( void(*function)() ) { setLdrDarkHandler(LDR_RIGHT, function); }
+    void setLdrRightBrightHandler( void(*function)() ) { setLdrBrightHandler(LDR_RIGHT, function); }
+    void setLdrRightNormalHandler( void(*function)() ) { setLdrNormalHandler(LDR_RIGHT, function); }
 
     void setBrightThresh(uint8_t t) { BRIGHT_THRESH = t; }
     void setDarkThresh(uint8_t t) { DARK_THRESH = t; }
 
     void initLightSensors();
-    uint8_t isLeftLDRTriggered();
-    uint8_t isRightLDRTriggered();
+    // the state as of the last sample, the handlers are called from update()
+    uint8_t isLDRTriggered(uint8_t ch) { return (ch < NUM_LDRS) ? ldr_state[ch] : (uint8_t)LDR_NORMAL; }
+    uint8_t isLeftLDRTriggered() { return isLDRTriggered(LDR_LEFT); }
+    uint8_t isRightLDRTriggered() { return isLDRTriggered(LDR_RIGHT); }
 
 
 
@@ -182,9 +412,34 @@ class RoboBrrd {
 
 
 
-    // -- speaker
+    // -- speaker (these don't block, the tones play during update())
     void robotgrrlSong();
 		void playTone(uint16_t tone, uint16_t duration);
+		void stopTone();
+		bool isTonePlaying();
+		uint8_t getToneOverflows() { return tone_overflows; }
+
+		// -- chirps slide from one frequency to another (in Hz), and queue up
+		// with the tones. wave is a SynthWave, see RoboBrrdSynth.h
+		void playChirp(uint16_t from, uint16_t to, uint16_t duration, uint8_t wave, uint8_t gap);
+		void setChirpEnvelope(uint8_t attack, uint8_t release, uint8_t volume);
+		void tweet();
+
+		// -- melodies (see the MELODY_NOTE macros above for the format)
+		enum Melody {
+			MELODY_ROBOTGRRL,
+			MELODY_CHIRP,
+			MELODY_QUESTION,
+			MELODY_HAPPY,
+			MELODY_SAD,
+			MELODY_ALARM,
+			NUM_MELODIES
+		};
+
+		void playMelody(uint8_t id);
+		void playMelodyTable(const uint8_t *melody);
+		void stopMelody();
+		bool isMelodyPlaying() { return melody_ptr != NULL; }
 
 
 
@@ -279,8 +534,7 @@ class RoboBrrd {
 		uint8_t lwing_servo_pin;
 		uint8_t led_pins[3];
 		uint8_t spkr_pin;
-		uint8_t ldr_left_pin;
-		uint8_t ldr_right_pin;
+		uint8_t ldr_pins[ROBOBRRD_LDRS];
 
 
 
@@ -290,48 +544,296 @@ class RoboBrrd {
 		Servo servo[4];
 		long last_servo_move[4];
 		uint8_t last_servo_pos[4];
-		uint8_t last_servos_moved[5];
+
+		uint8_t servo_power[4];
+		uint16_t servo_hold_time[4];
+		uint16_t servo_attaches[4];
+		uint16_t servo_detaches[4];
+
+		void servoWake(uint8_t ser);
+		void updateServoPower();
 
 		uint8_t rot_pos[3];
 		uint8_t beak_pos[3];
 		uint8_t rwing_pos[3];
 		uint8_t lwing_pos[3];
 
+		void recordServoMove(uint8_t ser, uint8_t pos);
+
+
+
+		// -- motion scheduler
+
+		// the number of moves or gestures that can be waiting to be
+		// played, for each priority
+		static const uint8_t MOTION_QUEUE_SIZE = 4;
+
+		enum MotionPriority {
+			MOTION_NORMAL,
+			MOTION_HIGH,
+			MOTION_PRIORITIES
+		};
+
+		// set in a MotionCmd mask when the servos should glide to their
+		// positions and all arrive at the end of del
+		static const uint8_t KEYFRAME_TIMED = 0x80;
+
+		// either a whole gesture, or a frame of moves for the servos
+		// in the mask when gesture is NULL
+		struct MotionCmd {
+			const uint8_t *gesture;
+			uint8_t mask;
+			uint8_t pos[4];
+			uint16_t del;
+		};
+
+		bool async_motion;
+		MotionCmd motion_queue[MOTION_PRIORITIES][MOTION_QUEUE_SIZE];
+		uint8_t motion_head[MOTION_PRIORITIES];
+		uint8_t motion_count[MOTION_PRIORITIES];
+		uint16_t motion_overflows;
+		uint16_t motion_preemptions;
+
+		bool motion_busy;
+		long motion_step_start;
+		uint16_t motion_step_del;
+
+		const uint8_t *gesture_ptr;
+		uint8_t gesture_pc;
+		bool gesture_looping;
+		uint8_t gesture_loops_left;
+
+		bool enqueueWaypoint(uint8_t ser, uint8_t pos, uint16_t del);
+		bool enqueueMotion(const MotionCmd *m, uint8_t priority = MOTION_NORMAL);
+		bool enqueueGesture(uint8_t id, uint8_t priority);
+		void updateMotion();
+		void runMotion();
+		bool nextGestureStep(uint8_t *ser, uint8_t *pos, uint16_t *del);
+		uint8_t gestureTarget(uint8_t ser, uint8_t target, uint8_t offset);
+
+		void (*motionComplete)();
+
+
+
+		// -- choreography
+
+		// the number of steps in each of the two chunk buffers
+		static const uint8_t CHOREO_CHUNK_SIZE = 8;
+
+		struct ChoreoStep {
+			uint8_t move;
+			uint16_t wait;
+		};
+
+		ChoreoStep choreo_buf[2][CHOREO_CHUNK_SIZE];
+		uint8_t choreo_len[2];
+		bool choreo_ready[2];
+		uint8_t choreo_play_buf;
+		uint8_t choreo_fill_buf;
+		uint8_t choreo_pos;
+		bool choreo_playing;
+		bool choreo_starving;
+		long choreo_last_step;
+		uint16_t choreo_wait;
+		uint8_t choreo_stream;
+		uint16_t choreo_starved;
+		uint16_t choreo_dropped;
+
+		void updateChoreo();
+		void sendChoreoFree();
+
+
+
+		// -- trajectories
+
+		// the trajectories are stepped at this period (ms), which
+		// matches the 50Hz refresh of the servos
+		static const uint8_t TRAJ_TICK = 20;
+
+		// pulse widths that the Servo library maps 0 and 180 degrees to
+		static const uint16_t SERVO_MIN_US = 544;
+		static const uint16_t SERVO_MAX_US = 2400;
+
+		// positions are in microseconds with 8 fractional bits, speeds
+		// are per tick and accelerations are per tick per tick
+		int32_t traj_pos[4];
+		int32_t traj_target[4];
+		int32_t traj_vel[4];
+		uint16_t traj_max_vel[4];
+		uint16_t traj_accel[4];
+		uint16_t traj_out[4];
+		uint16_t traj_ticks_left[4];
+		uint8_t traj_active_mask;
+		uint8_t traj_timed_mask;
+		uint8_t traj_known_mask;
+		uint8_t traj_dirty_mask;
+		long last_traj_tick;
+
+		uint16_t servo_writes;
+		uint16_t servo_writes_suppressed;
+
+		void setServoTarget(uint8_t ser, uint8_t pos);
+		void setServoTargetTimed(uint8_t ser, uint8_t pos, uint16_t duration);
+		void jumpServo(uint8_t ser, uint16_t us);
+		void updateTrajectories();
+		bool stepTrajectory(uint8_t ser);
+		void flushServos();
+		void waitMotion(uint16_t del);
+		uint16_t degToMicros(uint8_t pos);
+
 
 
 		// -- leds
-		float MAX_BRIGHTNESS;
+		uint8_t max_brightness;
+		bool eyes_gamma;
+
+		bool eyes_dither;
+		unsigned long last_dither;
+		uint16_t led_in12[3];
+		uint16_t led_out12[3];
+		uint8_t led_dither_acc[3];
 
 		float last_led_hsi[3];
 		uint8_t last_led_rgb[3];
 
-		void hsi2rgb(float H, float S, float I, int *rgb);
-    void rgb2hsv(uint8_t r, uint8_t g, uint8_t b, double *hsv);
+		// -- speaker
+		// enough for tweet(). melodies only keep 2 queued, so a long tune
+		// should be a melody rather than a lot of playTone()s
+		static const uint8_t TONE_QUEUE_SIZE = 4;
+
+		static const uint8_t TONE_SQUARE = 0xFF;
+
+		struct ToneCmd {
+			uint16_t tone; // half period in us, or Hz for a chirp
+			uint16_t tone_to; // Hz at the end of a chirp
+			uint16_t duration;
+			uint8_t gap; // ms of quiet after it
+			uint8_t wave; // TONE_SQUARE, or a SynthWave for a chirp
+		};
+
+		ToneCmd tone_queue[TONE_QUEUE_SIZE];
+		uint8_t tone_head;
+		uint8_t tone_count;
+		uint8_t tone_overflows;
+		bool tone_started;
+		unsigned long next_tone;
+		uint8_t chirp_attack;
+		uint8_t chirp_release;
+		uint8_t chirp_volume;
+
+		ToneCmd *nextToneCmd();
+		void enqueueTone(uint16_t tone, uint16_t duration, uint8_t gap);
+		void updateSpeaker();
+
+		// -- melody sequencer
+		const uint8_t *melody_ptr;
+		uint16_t melody_pc;
+		uint8_t melody_unit;
+		bool melody_looping;
+		uint8_t melody_loops_left;
+
+		void updateMelody();
+		static uint16_t noteHalfPeriod(uint8_t note);
+
+		// -- eye animations
+		static const uint8_t EYES_FRAME = 20;
+
+		enum EyeAnim {
+			EYES_STILL,
+			EYES_FADE_RGB,
+			EYES_FADE_HSI,
+			EYES_BLINK,
+			EYES_BREATHE,
+			EYES_HUE_CYCLE
+		};
+
+		uint8_t eye_anim;
+		unsigned long eye_anim_start;
+		unsigned long last_eye_frame;
+		uint16_t eye_anim_time;
+		uint16_t eye_anim_time2;
+		uint8_t eye_anim_times;
+		uint8_t eye_anim_level;
+		uint8_t eye_from[3]; // rgb, or S and I
+		uint8_t eye_to[3];
+		uint16_t eye_from_h;
+		uint16_t eye_to_h;
+
+		void startEyes(uint8_t anim, uint16_t duration);
+		void eyesHSIFromCurrent();
+		void updateEyes();
+		void showEyes(uint8_t r, uint8_t g, uint8_t b);
+
+		void refreshEyes();
+		uint8_t ledLevel(uint8_t in);
+		void writeEyes(uint8_t r, uint8_t g, uint8_t b);
+		void writeEyes12(uint16_t r, uint16_t g, uint16_t b);
+		uint16_t ledLevel12(uint16_t in);
+		void ditherEyes();
+
+		// -- the colour of the eyes is the rgb. the hsi version of it is
+		// only worked out when it's needed, unless it was set as hsi
+		uint8_t current_rgb[3];
+		uint16_t current_hue;
+		uint8_t current_sat;
+		uint8_t current_int;
+		bool current_hsi_valid;
+
+		void updateEyesHSI();
+		void showEyesHSI(uint16_t h, uint8_t s, uint8_t i);
 
 
 
 		// -- sensors
 		
-		// sample every x milliseconds
+		// sample every x milliseconds when the light is steady
 		static const uint16_t TIME_THRESH = 250;
 
+		// and every x milliseconds when it's changing, or close
+		// to setting off a trigger
+		static const uint16_t FAST_TIME_THRESH = 20;
+
 		// size of the sample window to determine the current
-		// sensor value (when averaged)
+		// sensor value (a moving average)
 		static const uint16_t SAMPLE_SIZE = 10;
 
+		// how often (ms) the average becomes the new baseline
+		static const uint16_t BASELINE_TIME = SAMPLE_SIZE * TIME_THRESH;
+
+		// a change of this much from the last sample, or this far
+		// from the baseline, counts as the light doing something
+		static const uint16_t ACTIVE_THRESH = 4;
+
 		// the threshold for ignoring raw data from the
 		// difference between current and previous value
 		static const uint16_t DELTA_THRESH = 80;
 
-		// the number of changes detected to count for
-		// is_changed to be set to true
+		// the number of samples in a row past a threshold
+		// before the state changes
 		static const uint16_t CHANGE_THRESH = 6;
 
 		// the amount of time (ms) from the last trigger to reset the
     // trigger count to 0 -- specifically when the trigger is 'fresh'
     static const uint16_t LDR_LAST_RESET = 250;
 
-    // the amount of time (ms) for a servo to be auto
+    // how long (ms) calibrating can wait for the light to settle
+    // before it uses what it has
+    static const uint16_t CALIBRATION_TIMEOUT = 10000;
+
+    // how often (ms) a new baseline can be saved to eeprom, after the
+    // first one
+    static const unsigned long LDR_SAVE_INTERVAL = 1800000UL;
+
+    // marks the light sensor calibration in eeprom as being there
+    static const uint8_t LDR_CAL_STAMP = 0xB2;
+    static const uint8_t LDR_CAL_FIELDS = 5;
+    static const uint8_t LDR_CAL_VALS = LDR_CAL_FIELDS * ROBOBRRD_LDRS;
+
+    // once dark or bright, the val has to come back past the threshold
+    // by this much to be normal again
+    static const uint16_t LDR_HYSTERESIS = 3;
+
+    // the default amount of time (ms) for a servo to be auto
     // detached after it has last moved
     static const uint16_t AUTO_DETACH_TIMER = 3000;
 
@@ -345,46 +847,65 @@ class RoboBrrd {
 
 		// enabled
 		bool light_sensors_enabled;
+		bool background_adc;
+
+		// everything below that's an array has one entry per channel
+
+		// background adc readings since the last sample
+		uint32_t adc_total[ROBOBRRD_LDRS];
+		uint16_t adc_count[ROBOBRRD_LDRS];
 
 		// sample related
 		long last_sampled;
-		uint16_t sample_count;
-		uint16_t ldr_left_total;
-		uint16_t ldr_right_total;
+		uint8_t sample_pos;
+		uint8_t sample_fill;
+		uint16_t window_count;
+		unsigned long window_start;
+		bool window_steady;
+		uint16_t sample_time;
+		uint16_t sample_time_min;
+		uint16_t sample_time_max;
+		uint16_t ldr_ring[ROBOBRRD_LDRS][SAMPLE_SIZE];
+		uint16_t ldr_total[ROBOBRRD_LDRS];
 		bool done_calibration;
+		uint8_t light_calibration;
+		unsigned long calibration_start;
+		bool calibration_blink;
+		unsigned long last_calibration_save;
+
+		void lightCalibrationVals(uint16_t **vals);
 
 		// raw vals
-		uint16_t current_ldr_left_raw;
-		uint16_t current_ldr_right_raw;
-		uint16_t previous_ldr_left_raw;
-		uint16_t previous_ldr_right_raw;
-		uint16_t ldr_left_min_raw;
-		uint16_t ldr_left_max_raw;
-		uint16_t ldr_right_min_raw;
-		uint16_t ldr_right_max_raw;
-
-		// averaged vals
-		uint16_t current_ldr_left_val;
-		uint16_t current_ldr_right_val;
-		uint16_t previous_ldr_left_val;
-		uint16_t previous_ldr_right_val;
+		uint16_t current_ldr_raw[ROBOBRRD_LDRS];
+		uint16_t previous_ldr_raw[ROBOBRRD_LDRS];
+		uint16_t ldr_min_raw[ROBOBRRD_LDRS];
+		uint16_t ldr_max_raw[ROBOBRRD_LDRS];
+
+		// averaged vals (previous is the baseline for the triggers)
+		uint16_t current_ldr_val[ROBOBRRD_LDRS];
+		uint16_t previous_ldr_val[ROBOBRRD_LDRS];
 
 		// trigger related
-		uint16_t left_dark_thresh;
-		uint16_t left_bright_thresh;
-		uint16_t right_dark_thresh;
-		uint16_t right_bright_thresh;
+		uint16_t dark_thresh[ROBOBRRD_LDRS];
+		uint16_t bright_thresh[ROBOBRRD_LDRS];
+
+		uint8_t ldr_state[ROBOBRRD_LDRS];
+		uint8_t trigger_sample[ROBOBRRD_LDRS];
+		unsigned long last_trigger[ROBOBRRD_LDRS];
+
+		void triggerLdr(uint8_t ch);
+		bool updateLdrState(uint8_t ch);
+		uint8_t ldrLevel(uint16_t val, uint16_t dark, uint16_t bright);
 
 		uint16_t math_abs(uint16_t a, uint16_t b);
-		double threeway_max(double a, double b, double c);
-    double threeway_min(double a, double b, double c);
 
     void calibrateLightSensors();
+    bool isLightActive();
+    void drainADC();
 
-    void (*ldrLeftDark)();
-		void (*ldrLeftBright)();
-		void (*ldrRightDark)();
-		void (*ldrRightBright)();
+    void (*ldrDark[ROBOBRRD_LDRS])();
+		void (*ldrBright[ROBOBRRD_LDRS])();
+		void (*ldrNormal[ROBOBRRD_LDRS])();
 
 
 
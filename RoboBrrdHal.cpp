@@ -0,0 +1,354 @@
+/**
+ * Copyright (c) 2014 Erin Kennedy, All rights reserved.
+ * Licensed under MIT License, see license.txt for more info.
+ */
+
+#include "RoboBrrdHal.h"
+
+// the host backend has its own version of all of this
+#ifndef ROBOBRRD_HOST
+
+#include <avr/interrupt.h>
+
+
+/**
+ * Speaker
+ */
+
+// timer 2 in fast pwm mode with OCR2A as the top, toggling the pin from
+// the compare interrupt. the prescaler is picked for each tone so the half
+// period fits in 8 bits. it's still pwm, so pin 3 (OC2B) keeps its
+// brightness during a tone, just with the tone's period
+static const uint16_t tone_prescalers[7] = { 1, 8, 32, 64, 128, 256, 1024 };
+
+static volatile uint8_t *tone_port;
+static uint8_t tone_mask;
+static volatile uint32_t tone_toggles = 0;
+static volatile bool tone_on = false;
+
+// the synth voice is only touched by the interrupt while synth_on is set
+static SynthVoice synth_voice;
+static volatile bool synth_on = false;
+
+
+// -- the last analogWrite to timer 2's pins (11 and 3 on the 328), -1
+// if there hasn't been one. OC2A is the top during a tone, so pin 11 has
+// to wait until it's over
+static volatile int16_t pwm_a = -1;
+static volatile int16_t pwm_b = -1;
+static uint8_t pwm_pin_a;
+static uint8_t pwm_pin_b;
+
+
+// -- what analogWrite does to one of timer 2's pins, but it's safe in the
+// interrupt and works during a tone too (top is OCR2A then, otherwise 0)
+static void timer2Pwm(uint8_t pin, int16_t duty, volatile uint8_t *ocr, uint8_t com, uint8_t top) {
+
+	if(duty < 0) return;
+
+	uint16_t ticks = duty;
+
+	// the share of the tone's period that's high
+	if(top) ticks = ((uint16_t)duty * (top + 1) + 128) >> 8;
+
+	if(ticks == 0 || duty >= 255) {
+		TCCR2A &= ~_BV(com);
+		volatile uint8_t *out = portOutputRegister(digitalPinToPort(pin));
+		if(duty) {
+			*out |= digitalPinToBitMask(pin);
+		} else {
+			*out &= ~digitalPinToBitMask(pin);
+		}
+		return;
+	}
+
+	*ocr = top ? ticks - 1 : ticks;
+	TCCR2A |= _BV(com);
+
+}
+
+
+// -- put timer 2 back how the arduino core sets it up (phase correct pwm,
+// divide by 64), with the pins how they were last analogWrite'd
+static void timer2Restore() {
+	TIMSK2 &= ~_BV(OCIE2A);
+	TCCR2A = _BV(WGM20);
+	TCCR2B = _BV(CS22);
+	OCR2A = 0;
+	timer2Pwm(pwm_pin_a, pwm_a, &OCR2A, COM2A1, 0);
+	timer2Pwm(pwm_pin_b, pwm_b, &OCR2B, COM2B1, 0);
+}
+
+
+// -- fast pwm with OCR2A as the top, from the compare interrupt
+static void timer2Tone(uint8_t cs, uint8_t top) {
+	TCCR2A = _BV(WGM21) | _BV(WGM20);
+	TCCR2B = _BV(WGM22) | cs;
+	OCR2A = top;
+	TCNT2 = 0;
+	timer2Pwm(pwm_pin_b, pwm_b, &OCR2B, COM2B1, top);
+}
+
+
+void hal_analogWrite(uint8_t pin, int val) {
+
+	uint8_t timer = digitalPinToTimer(pin);
+
+	if(timer != TIMER2A && timer != TIMER2B) {
+		analogWrite(pin, val);
+		return;
+	}
+
+	if(val < 0) val = 0;
+	if(val > 255) val = 255;
+
+	uint8_t oldSREG = SREG;
+	cli();
+
+	if(timer == TIMER2A) {
+		pwm_a = val;
+		pwm_pin_a = pin;
+	} else {
+		pwm_b = val;
+		pwm_pin_b = pin;
+	}
+
+	if(!tone_on) {
+		analogWrite(pin, val);
+	} else if(timer == TIMER2B) {
+		timer2Pwm(pin, val, &OCR2B, COM2B1, OCR2A);
+	}
+
+	SREG = oldSREG;
+
+}
+
+
+void hal_toneStart(uint8_t pin, uint16_t half_period, uint16_t duration) {
+
+	hal_toneStop();
+
+	if(half_period == 0 || duration == 0) return;
+
+	uint32_t ticks = (uint32_t)half_period * (F_CPU / 1000000UL);
+
+	uint8_t cs = 1;
+	while(cs < 7 && ticks / tone_prescalers[cs-1] > 256) cs++;
+
+	uint16_t ocr = ticks / tone_prescalers[cs-1];
+	if(ocr > 256) ocr = 256;
+	if(ocr == 0) ocr = 1;
+
+	pinMode(pin, OUTPUT);
+
+	uint8_t oldSREG = SREG;
+	cli();
+
+	tone_port = portOutputRegister(digitalPinToPort(pin));
+	tone_mask = digitalPinToBitMask(pin);
+	tone_toggles = ((uint32_t)duration * 1000UL) / half_period;
+
+	timer2Tone(cs, ocr - 1);
+
+	tone_on = true;
+	TIMSK2 |= _BV(OCIE2A);
+
+	SREG = oldSREG;
+
+}
+
+
+// -- the timer runs at SYNTH_RATE and each interrupt works out one sample.
+// that's about 5us every 64us, short enough that the servo pulses (from
+// timer 1's interrupt) only get a few us of jitter
+void hal_synthStart(uint8_t pin, const SynthChirp *chirp) {
+
+	hal_toneStop();
+
+	if(chirp->duration == 0 || chirp->volume == 0) return;
+
+	SynthVoice v;
+	synthStart(&v, chirp);
+
+	pinMode(pin, OUTPUT);
+
+	uint8_t oldSREG = SREG;
+	cli();
+
+	tone_port = portOutputRegister(digitalPinToPort(pin));
+	tone_mask = digitalPinToBitMask(pin);
+	synth_voice = v;
+
+	timer2Tone(_BV(CS21), (F_CPU / 8 / SYNTH_RATE) - 1);
+
+	synth_on = true;
+	tone_on = true;
+	TIMSK2 |= _BV(OCIE2A);
+
+	SREG = oldSREG;
+
+}
+
+
+void hal_toneStop() {
+
+	uint8_t oldSREG = SREG;
+	cli();
+
+	if(tone_on) {
+		timer2Restore();
+		*tone_port &= ~tone_mask;
+		tone_on = false;
+		synth_on = false;
+	}
+
+	SREG = oldSREG;
+
+}
+
+
+bool hal_tonePlaying() {
+	return tone_on;
+}
+
+
+ISR(TIMER2_COMPA_vect) {
+
+	if(synth_on) {
+
+		if(synthBit(&synth_voice, synthNext(&synth_voice))) {
+			*tone_port |= tone_mask;
+		} else {
+			*tone_port &= ~tone_mask;
+		}
+
+		if(synth_voice.steps == 0) {
+			timer2Restore();
+			*tone_port &= ~tone_mask;
+			synth_on = false;
+			tone_on = false;
+		}
+
+		return;
+
+	}
+
+	if(tone_toggles == 0) {
+		timer2Restore();
+		*tone_port &= ~tone_mask;
+		tone_on = false;
+		return;
+	}
+
+	*tone_port ^= tone_mask;
+	tone_toggles--;
+
+}
+
+/**
+ * Background Analog Reads
+ */
+
+// a single producer (the interrupt moves the head) and a single consumer
+// (hal_adcRead moves the tail), so the buffer doesn't need locking. each
+// entry is one word, the pin's index in the top bits and the reading in
+// the bottom 10
+static uint8_t adc_channels[HAL_ADC_PINS];
+static uint8_t adc_num = 0;
+static uint8_t adc_cur = 0;
+
+static volatile uint16_t adc_buf[HAL_ADC_BUFFER];
+static volatile uint8_t adc_head = 0;
+static volatile uint8_t adc_tail = 0;
+static volatile uint16_t adc_overflows = 0;
+
+
+bool hal_adcStart(const uint8_t *pins, uint8_t num) {
+
+	hal_adcStop();
+
+	if(num == 0 || num > HAL_ADC_PINS) return false;
+
+	for(uint8_t i=0; i<num; i++) {
+		// -- A0 or 0 both mean channel 0, the same as analogRead
+		adc_channels[i] = (pins[i] >= A0) ? pins[i] - A0 : pins[i];
+	}
+
+	adc_num = num;
+	adc_cur = 0;
+	adc_head = 0;
+	adc_tail = 0;
+
+	// avcc reference like analogRead, the first pin, and convert whenever
+	// timer 0 overflows. divide by 128 is the same adc clock analogRead uses
+	ADMUX = _BV(REFS0) | (adc_channels[0] & 0x07);
+	ADCSRB = _BV(ADTS2);
+	ADCSRA = _BV(ADEN) | _BV(ADATE) | _BV(ADIE) | _BV(ADPS2) | _BV(ADPS1) | _BV(ADPS0);
+
+	return true;
+
+}
+
+
+void hal_adcStop() {
+
+	// back to how the arduino core leaves it, for analogRead
+	ADCSRA = _BV(ADEN) | _BV(ADPS2) | _BV(ADPS1) | _BV(ADPS0);
+	ADCSRB = 0;
+	adc_num = 0;
+
+}
+
+
+bool hal_adcRead(uint8_t *index, uint16_t *val) {
+
+	uint8_t tail = adc_tail;
+	if(tail == adc_head) return false;
+
+	uint16_t entry = adc_buf[tail];
+	adc_tail = (tail + 1) & (HAL_ADC_BUFFER-1);
+
+	*index = entry >> 12;
+	*val = entry & 0x3FF;
+
+	return true;
+
+}
+
+
+uint16_t hal_adcOverflows() {
+
+	uint8_t oldSREG = SREG;
+	cli();
+	uint16_t n = adc_overflows;
+	SREG = oldSREG;
+
+	return n;
+
+}
+
+
+ISR(ADC_vect) {
+
+	uint16_t val = ADC;
+	uint8_t index = adc_cur;
+
+	// -- the next conversion won't start until the next trigger, so the
+	// mux can change now
+	if(++adc_cur >= adc_num) adc_cur = 0;
+	ADMUX = _BV(REFS0) | (adc_channels[adc_cur] & 0x07);
+
+	uint8_t head = adc_head;
+	uint8_t next = (head + 1) & (HAL_ADC_BUFFER-1);
+
+	if(next == adc_tail) {
+		adc_overflows++;
+		return;
+	}
+
+	adc_buf[head] = ((uint16_t)index << 12) | val;
+	adc_head = next;
+
+}
+
+#endif
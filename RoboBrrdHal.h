@@ -0,0 +1,89 @@
+/**
+ * RoboBrrd Hardware Abstraction
+ * -----------------------------
+ *
+ * Everything the library does to the hardware goes through the hal
+ * functions below. On the robot they are inline calls straight into the
+ * Arduino core, so they cost nothing.
+ *
+ * Define ROBOBRRD_HOST (and put extras/host on the include path) to build
+ * the library on an ordinary Linux machine instead. The host backend
+ * gives you a virtual clock, an EEPROM backed by a file, scripted analog
+ * inputs and a record of every pwm, pin and servo write. See
+ * extras/host/readme.md for more info.
+ *
+ * Copyright (c) 2014 Erin Kennedy.
+ * Licensed under MIT License, see license.txt for more info.
+ */
+
+#ifndef _ROBOBRRD_HAL_H_
+#define _ROBOBRRD_HAL_H_
+
+#ifdef ROBOBRRD_HOST
+	#include "HostHal.h"
+#endif
+
+#include <Servo.h>
+#include <EEPROM.h>
+
+#if ARDUINO >= 100
+	#include "Arduino.h"
+#else
+	#include "WProgram.h"
+#endif
+
+#include <avr/pgmspace.h>
+
+#include "RoboBrrdSynth.h"
+
+
+// -- time
+static inline unsigned long hal_millis() { return millis(); }
+static inline unsigned long hal_micros() { return micros(); }
+static inline void hal_delay(unsigned long ms) { delay(ms); }
+static inline void hal_delayMicroseconds(unsigned int us) { delayMicroseconds(us); }
+
+// -- pins
+static inline void hal_pinMode(uint8_t pin, uint8_t mode) { pinMode(pin, mode); }
+static inline void hal_digitalWrite(uint8_t pin, uint8_t val) { digitalWrite(pin, val); }
+static inline int hal_analogRead(uint8_t pin) { return analogRead(pin); }
+
+// analogWrite, except that timer 2's pins keep going while it plays a tone
+void hal_analogWrite(uint8_t pin, int val);
+
+// -- background analog reads
+// the adc reads the pins one after another from its interrupt, started
+// by timer 0 overflowing (about every 1ms, so each of n pins is read
+// every n ms). the readings queue up until hal_adcRead takes them, and
+// if nobody does the newest ones are dropped and counted. don't use
+// hal_analogRead while this is running, they share the adc
+#define HAL_ADC_PINS 4
+#define HAL_ADC_BUFFER 16 // has to be a power of 2
+
+bool hal_adcStart(const uint8_t *pins, uint8_t num);
+void hal_adcStop();
+bool hal_adcRead(uint8_t *index, uint16_t *val); // index into pins
+uint16_t hal_adcOverflows();
+
+// -- speaker
+// a square wave on pin that flips every half_period us, for duration ms,
+// without blocking. it runs off timer 2, which also does the pwm on pins 3
+// and 11. pin 3 (the red eye) keeps its brightness during the tone, pin 11
+// is digital until it's over, and both go back to their last
+// hal_analogWrite after
+void hal_toneStart(uint8_t pin, uint16_t half_period, uint16_t duration);
+void hal_toneStop();
+bool hal_tonePlaying();
+
+// the same, but with the synth on timer 2 instead (see RoboBrrdSynth.h).
+// hal_toneStop and hal_tonePlaying work for both
+void hal_synthStart(uint8_t pin, const SynthChirp *chirp);
+
+// -- eeprom
+static inline uint8_t hal_eepromRead(int addr) { return EEPROM.read(addr); }
+static inline void hal_eepromWrite(int addr, uint8_t val) { EEPROM.write(addr, val); }
+
+// only writes when it's different, to save wear on the eeprom
+static inline void hal_eepromUpdate(int addr, uint8_t val) { if(hal_eepromRead(addr) != val) hal_eepromWrite(addr, val); }
+
+#endif
@@ -0,0 +1,186 @@
+/**
+ * RoboBrrd Synth
+ * --------------
+ *
+ * A tiny direct digital synthesis voice for the speaker. A 16 bit phase
+ * accumulator steps through a 64 sample wavetable at SYNTH_RATE, and every
+ * SYNTH_CONTROL samples the frequency slides a bit (for chirps) and the
+ * envelope moves. The speaker pin isn't a pwm pin, so the samples go out
+ * as 1 bit sigma-delta: the pin is high for a share of the samples that
+ * matches the level.
+ *
+ * Everything here is plain integer math with no hardware in it, so the
+ * same code runs in the timer interrupt on the robot and in the host
+ * backend (which can write the samples to a WAV file).
+ *
+ * Copyright (c) 2014 Erin Kennedy.
+ * Licensed under MIT License, see license.txt for more info.
+ */
+
+#ifndef _ROBOBRRD_SYNTH_H_
+#define _ROBOBRRD_SYNTH_H_
+
+#include <avr/pgmspace.h>
+
+
+// -- 16MHz / 8 / 128, or 8MHz / 8 / 64
+#define SYNTH_RATE 15625UL
+
+// samples between envelope and sweep steps (about 2ms)
+#define SYNTH_CONTROL 32
+
+enum SynthWave {
+	SYNTH_SINE,
+	SYNTH_TRIANGLE,
+	SYNTH_SQUARE,
+	SYNTH_SAW,
+	SYNTH_WAVES
+};
+
+// -- a sound to play: a wave sliding from one frequency to another (in Hz),
+// fading in over attack ms and out over the last release ms
+struct SynthChirp {
+	uint16_t from;
+	uint16_t to;
+	uint16_t duration;
+	uint8_t wave;
+	uint8_t attack;
+	uint8_t release;
+	uint8_t volume;
+};
+
+struct SynthVoice {
+	const int8_t *wave;
+	uint16_t phase;
+	uint16_t inc;          // added to phase every sample
+	uint32_t inc_q8;       // the same with 8 more bits, so it can slide slowly
+	int32_t sweep;         // added to inc_q8 every control step
+	uint16_t amp;          // envelope, 8.8
+	uint16_t amp_max;
+	uint16_t attack_step;
+	uint16_t release_step;
+	uint16_t release_at;   // control steps from the end that the release starts
+	uint16_t steps;        // control steps left, 0 when it's over
+	uint8_t level;
+	uint8_t count;         // samples until the next control step
+	uint8_t acc;           // sigma-delta
+};
+
+
+static const int8_t synth_waves[SYNTH_WAVES][64] PROGMEM = {
+	{ // sine
+		   0,   12,   25,   37,   49,   60,   71,   81,   90,   98,  106,  112,  117,  122,  125,  126,
+		 127,  126,  125,  122,  117,  112,  106,   98,   90,   81,   71,   60,   49,   37,   25,   12,
+		   0,  -12,  -25,  -37,  -49,  -60,  -71,  -81,  -90,  -98, -106, -112, -117, -122, -125, -126,
+		-127, -126, -125, -122, -117, -112, -106,  -98,  -90,  -81,  -71,  -60,  -49,  -37,  -25,  -12
+	},
+	{ // triangle
+		   0,    8,   16,   24,   32,   40,   48,   56,   64,   71,   79,   87,   95,  103,  111,  119,
+		 127,  119,  111,  103,   95,   87,   79,   71,   64,   56,   48,   40,   32,   24,   16,    8,
+		   0,   -8,  -16,  -24,  -32,  -40,  -48,  -56,  -64,  -71,  -79,  -87,  -95, -103, -111, -119,
+		-127, -119, -111, -103,  -95,  -87,  -79,  -71,  -64,  -56,  -48,  -40,  -32,  -24,  -16,   -8
+	},
+	{ // square
+		 127,  127,  127,  127,  127,  127,  127,  127,  127,  127,  127,  127,  127,  127,  127,  127,
+		 127,  127,  127,  127,  127,  127,  127,  127,  127,  127,  127,  127,  127,  127,  127,  127,
+		-127, -127, -127, -127, -127, -127, -127, -127, -127, -127, -127, -127, -127, -127, -127, -127,
+		-127, -127, -127, -127, -127, -127, -127, -127, -127, -127, -127, -127, -127, -127, -127, -127
+	},
+	{ // saw
+		-127, -123, -119, -115, -111, -107, -103,  -99,  -95,  -91,  -87,  -83,  -79,  -75,  -71,  -67,
+		 -62,  -58,  -54,  -50,  -46,  -42,  -38,  -34,  -30,  -26,  -22,  -18,  -14,  -10,   -6,   -2,
+		   2,    6,   10,   14,   18,   22,   26,   30,   34,   38,   42,   46,   50,   54,   58,   62,
+		  67,   71,   75,   79,   83,   87,   91,   95,   99,  103,  107,  111,  115,  119,  123,  127
+	}
+};
+
+
+// -- Hz to phase step (with the extra 8 bits), up to the nyquist frequency
+static inline uint32_t synthInc(uint16_t hz) {
+	if(hz > SYNTH_RATE/2) hz = SYNTH_RATE/2;
+	return ((uint32_t)hz * ((1UL << 30) / SYNTH_RATE)) >> 6;
+}
+
+
+// -- ms to control steps
+static inline uint16_t synthSteps(uint16_t ms) {
+	return ((uint32_t)ms * SYNTH_RATE) / (1000UL * SYNTH_CONTROL);
+}
+
+
+// -- all of the division happens here, not in the interrupt
+static inline void synthStart(SynthVoice *v, const SynthChirp *c) {
+
+	v->wave = synth_waves[c->wave < SYNTH_WAVES ? c->wave : (uint8_t)SYNTH_SINE];
+	v->phase = 0;
+
+	v->steps = synthSteps(c->duration);
+	if(v->steps == 0) v->steps = 1;
+
+	v->inc_q8 = synthInc(c->from);
+	v->sweep = ((int32_t)synthInc(c->to) - (int32_t)v->inc_q8) / (int32_t)v->steps;
+	v->inc = v->inc_q8 >> 8;
+
+	uint16_t attack = synthSteps(c->attack);
+	uint16_t release = synthSteps(c->release);
+	if(attack > v->steps) attack = v->steps;
+	if(release > v->steps - attack) release = v->steps - attack;
+
+	v->amp_max = (uint16_t)c->volume << 8;
+	v->attack_step = attack ? v->amp_max / attack : v->amp_max;
+	v->release_step = release ? v->amp_max / release : v->amp_max;
+	v->release_at = release;
+	v->amp = attack ? 0 : v->amp_max;
+
+	v->level = v->amp >> 8;
+	v->count = SYNTH_CONTROL;
+	v->acc = 0;
+
+}
+
+
+static inline void synthControl(SynthVoice *v) {
+
+	v->count = SYNTH_CONTROL;
+
+	if(v->steps == 0) return;
+	v->steps--;
+
+	if(v->steps < v->release_at) {
+		v->amp = (v->amp > v->release_step) ? v->amp - v->release_step : 0;
+	} else if(v->amp < v->amp_max) {
+		v->amp = (v->amp_max - v->amp > v->attack_step) ? v->amp + v->attack_step : v->amp_max;
+	}
+
+	v->level = v->amp >> 8;
+
+	v->inc_q8 += v->sweep;
+	v->inc = v->inc_q8 >> 8;
+
+}
+
+
+// -- the next sample, 0-255. 0 is quiet, so the pin stays low between sounds
+static inline uint8_t synthNext(SynthVoice *v) {
+
+	v->phase += v->inc;
+	uint8_t s = (uint8_t)pgm_read_byte(&v->wave[v->phase >> 10]) ^ 0x80;
+
+	if(--v->count == 0) synthControl(v);
+
+	return ((uint16_t)s * v->level) >> 8;
+
+}
+
+
+// -- 1 bit sigma-delta, the pin level for this sample
+static inline uint8_t synthBit(SynthVoice *v, uint8_t sample) {
+
+	uint16_t acc = (uint16_t)v->acc + sample;
+	v->acc = acc;
+
+	return acc >> 8;
+
+}
+
+#endif
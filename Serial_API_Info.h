@@ -53,9 +53,34 @@
    @F<key>,<val>!
 
  * Play tone on speaker (where key is 1/10th the play duration
- * and val is the frequency to play)
+ * and val is half of the period in microseconds, so 500 is 1kHz).
+ * Tones queue up and play in the background. A val of 0 stops
+ * the tone and anything queued after it
    @P<key>,<val>!
 
+ * Melody (where key is 0 to stop, 1 to play melody number val,
+ * or 2 to ask if one is playing). Melodies play in the
+ * background. The built in ones are 0 robotgrrl, 1 chirp,
+ * 2 question, 3 happy, 4 sad and 5 alarm (which doesn't stop)
+   @M<key>,<val>!
+
+ * --> Response to key 2 will be in the format of this (where
+ * val is 1 if a melody is playing)
+   #M0,<val>!
+
+ * Light sensor calibration (where key is 0 to ask how it's
+ * going, 1 to calibrate again, or 2 to forget the one saved in
+ * EEPROM). Calibration happens in the background after power
+ * on, and the light callbacks aren't called until it has a
+ * baseline (or it has loaded the saved one)
+   @K<key>,<val>!
+
+ * --> Response to key 0 will be in the format of this (where
+ * val is 0 calibrating, 1 calibrated, 2 timed out because
+ * the light never settled, or 3 using the saved baseline
+ * while it calibrates)
+   #K0,<val>!
+
  * Get Left LDR reading (where key and val are anything)
    @I<key>,<val>!
 
@@ -125,12 +150,56 @@
  * (hypertastic))
    @Z1,<val>!
 
+ * Get the number of movements waiting in the motion queue
+ * (where val is anything)
+   @Q0,<val>!
+
+ * --> Response will be in the format of this (where val is
+ * the queue depth)
+   #Q0,<val>!
+
+ * Get the number of movements dropped because the motion queue
+ * was full (where val is anything)
+   @Q1,<val>!
+
+ * --> Response will be in the format of this (where val is
+ * the number of dropped movements)
+   #Q1,<val>!
+
+ * Get the number of movements that were cut off by a high
+ * priority movement (where val is anything)
+   @Q2,<val>!
+
+ * --> Response will be in the format of this (where val is
+ * the number of cut off movements)
+   #Q2,<val>!
+
+ * Get the number of servo writes (where val is anything)
+   @Q3,<val>!
+
+ * --> Response will be in the format of this (where val is
+ * the number of writes sent to the servos)
+   #Q3,<val>!
+
+ * Get the number of servo writes that were dropped, because
+ * they would not have changed anything (where val is anything)
+   @Q4,<val>!
+
+ * --> Response will be in the format of this (where val is
+ * the number of dropped writes)
+   #Q4,<val>!
+
 
 
 
  * Movements
  * ---------------------------------------
 
+ * Movements (and the servo moves above) are put in a queue and
+ * played one after another, so the API stays responsive while
+ * RoboBrrd is moving. The home movements and servos detach are
+ * high priority, and cut off whatever movement is playing.
+
  * Rotate left
    #S0,0!
 
@@ -217,6 +286,32 @@
 
 
 
+ * Choreography
+ * ---------------------------------------
+
+ * A long dance can be streamed to RoboBrrd in chunks of up to 8
+ * steps. RoboBrrd plays one chunk while the next one is sent, and
+ * lets you know how many chunk buffers are free (0-2) whenever
+ * that changes, so you know when to send the next chunk:
+   #C3,<free>!
+
+ * Add a step to the chunk being sent (where key is the movement
+ * number, see the Gesture list in RoboBrrd.h, and val is the time
+ * in ms to wait before the next step)
+   #D<key>,<val>!
+
+ * End of chunk (where val is anything)
+   #C2,<val>!
+
+ * Start playing (where val is anything)
+   #C0,<val>!
+
+ * Stop playing and clear the chunks (where val is anything)
+   #C1,<val>!
+
+
+
+
  * EEPROM
  * ---------------------------------------
 
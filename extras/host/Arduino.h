@@ -0,0 +1,153 @@
+/**
+ * Host Arduino Core
+ * -----------------
+ *
+ * Just enough of the Arduino core for RoboBrrd (and the Streaming and
+ * Promulgate libraries) to compile on Linux. Time, pins and the serial
+ * port are all simulated by HostHal.cpp.
+ *
+ * Copyright (c) 2014 Erin Kennedy.
+ * Licensed under MIT License, see license.txt for more info.
+ */
+
+#ifndef _HOST_ARDUINO_H_
+#define _HOST_ARDUINO_H_
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <math.h>
+
+#define ARDUINO 105
+
+#define HIGH 0x1
+#define LOW 0x0
+
+#define INPUT 0x0
+#define OUTPUT 0x1
+#define INPUT_PULLUP 0x2
+
+#define DEC 10
+#define HEX 16
+#define OCT 8
+#define BIN 2
+
+#define A0 14
+#define A1 15
+#define A2 16
+#define A3 17
+#define A4 18
+#define A5 19
+#define A6 20
+#define A7 21
+
+#define NUM_PINS 22
+
+#undef abs
+#define min(a,b) ((a)<(b)?(a):(b))
+#define max(a,b) ((a)>(b)?(a):(b))
+#define abs(x) ((x)>0?(x):-(x))
+#define constrain(amt,low,high) ((amt)<(low)?(low):((amt)>(high)?(high):(amt)))
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+int digitalRead(uint8_t pin);
+int analogRead(uint8_t pin);
+void analogWrite(uint8_t pin, int val);
+
+long random(long howbig);
+long random(long howsmall, long howbig);
+void randomSeed(unsigned long seed);
+
+static inline void noInterrupts() { }
+static inline void interrupts() { }
+
+
+// -- flash strings are just strings here
+class __FlashStringHelper;
+#define F(string_literal) (reinterpret_cast<const __FlashStringHelper *>(string_literal))
+
+
+/**
+ * Print
+ */
+
+class Print {
+
+	public:
+
+		virtual ~Print() { }
+
+		virtual size_t write(uint8_t c) = 0;
+		virtual size_t write(const uint8_t *buf, size_t len);
+		size_t write(const char *str) { return str == NULL ? 0 : write((const uint8_t *)str, strlen(str)); }
+
+		size_t print(const __FlashStringHelper *str) { return write((const char *)str); }
+		size_t print(const char *str) { return write(str); }
+		size_t print(char c) { return write((uint8_t)c); }
+		size_t print(unsigned char n, int base = DEC) { return print((unsigned long)n, base); }
+		size_t print(int n, int base = DEC) { return print((long)n, base); }
+		size_t print(unsigned int n, int base = DEC) { return print((unsigned long)n, base); }
+		size_t print(long n, int base = DEC);
+		size_t print(unsigned long n, int base = DEC);
+		size_t print(double n, int digits = 2);
+
+		size_t println() { return write("\r\n"); }
+		template<class T> size_t println(T val) { size_t n = print(val); return n + println(); }
+		template<class T> size_t println(T val, int fmt) { size_t n = print(val, fmt); return n + println(); }
+
+};
+
+
+/**
+ * Stream
+ */
+
+class Stream : public Print {
+
+	public:
+
+		virtual int available() = 0;
+		virtual int read() = 0;
+		virtual int peek() = 0;
+		virtual void flush() { }
+
+};
+
+
+/**
+ * HardwareSerial
+ */
+
+// -- everything written goes to the trace (see hostSetSerialEcho), and
+// anything handed to hostSerialInject comes back out of read()
+class HardwareSerial : public Stream {
+
+	public:
+
+		void begin(unsigned long baud) { (void)baud; }
+		void end() { }
+
+		virtual size_t write(uint8_t c);
+		using Print::write;
+
+		virtual int available();
+		virtual int read();
+		virtual int peek();
+
+		operator bool() { return true; }
+
+};
+
+extern HardwareSerial Serial;
+
+#endif
@@ -0,0 +1,30 @@
+/**
+ * Host EEPROM
+ * -----------
+ *
+ * 1KB of simulated EEPROM (like the ATmega328). Use hostEepromLoad and
+ * hostEepromSave to keep it in a file between runs.
+ *
+ * Copyright (c) 2014 Erin Kennedy.
+ * Licensed under MIT License, see license.txt for more info.
+ */
+
+#ifndef _HOST_EEPROM_H_
+#define _HOST_EEPROM_H_
+
+#include "Arduino.h"
+
+#define HOST_EEPROM_SIZE 1024
+
+class EEPROMClass {
+
+	public:
+
+		uint8_t read(int addr);
+		void write(int addr, uint8_t val);
+
+};
+
+extern EEPROMClass EEPROM;
+
+#endif
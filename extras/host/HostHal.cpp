@@ -0,0 +1,708 @@
+/**
+ * Copyright (c) 2014 Erin Kennedy, All rights reserved.
+ * Licensed under MIT License, see license.txt for more info.
+ */
+
+#include "HostHal.h"
+#include "RoboBrrdHal.h"
+#include "Servo.h"
+#include "EEPROM.h"
+
+HardwareSerial Serial;
+EEPROMClass EEPROM;
+
+static unsigned long host_us = 0;
+static unsigned int host_read_cost = 10;
+
+static int host_analog[NUM_PINS];
+static HostAnalogSource host_analog_src = NULL;
+static unsigned long host_analog_reads = 0;
+
+// the adc on the robot is started by timer 0 overflowing, every 1024us
+#define HOST_ADC_PERIOD 1024UL
+
+static uint8_t host_adc_pins[HAL_ADC_PINS];
+static uint8_t host_adc_num = 0;
+static uint8_t host_adc_cur = 0;
+static unsigned long host_adc_next = 0;
+static uint16_t host_adc_buf[HAL_ADC_BUFFER];
+static uint8_t host_adc_head = 0;
+static uint8_t host_adc_tail = 0;
+static uint16_t host_adc_overflows = 0;
+
+static int host_pin[NUM_PINS];
+static int host_pwm[NUM_PINS];
+static int host_servo[NUM_PINS] = { -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+                                    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 };
+static unsigned long host_writes[HOST_OUTPUTS];
+static FILE *host_trace = NULL;
+
+static uint8_t host_eeprom[HOST_EEPROM_SIZE];
+
+#define HOST_SERIAL_SIZE 256
+static char host_rx[HOST_SERIAL_SIZE];
+static size_t host_rx_head = 0;
+static size_t host_rx_len = 0;
+static FILE *host_echo = NULL;
+
+static const char *host_output_names[HOST_OUTPUTS] = { "pin", "pwm", "servo", "eeprom", "tone", "chirp" };
+
+static int host_tone_pin = -1;
+static unsigned long host_tone_start = 0;
+static unsigned long host_tone_end = 0;
+static uint16_t host_tone_half = 0;
+static bool host_synth_on = false;
+static SynthVoice host_voice;
+
+static FILE *host_audio = NULL;
+static bool host_audio_bits = false;
+static unsigned long host_audio_samples = 0;
+
+
+/**
+ * Clock
+ */
+
+void hostSetTime(unsigned long ms) {
+	host_us = ms * 1000UL;
+}
+
+
+void hostAdvance(unsigned long ms) {
+	host_us += ms * 1000UL;
+}
+
+
+void hostAdvanceMicros(unsigned long us) {
+	host_us += us;
+}
+
+
+unsigned long hostMicros() {
+	return host_us;
+}
+
+
+void hostSetReadCost(unsigned int us) {
+	host_read_cost = us;
+}
+
+
+unsigned long millis() {
+	host_us += host_read_cost;
+	return host_us / 1000UL;
+}
+
+
+unsigned long micros() {
+	host_us += host_read_cost;
+	return host_us;
+}
+
+
+void delay(unsigned long ms) {
+	host_us += ms * 1000UL;
+}
+
+
+void delayMicroseconds(unsigned int us) {
+	host_us += us;
+}
+
+
+/**
+ * Pins
+ */
+
+void pinMode(uint8_t pin, uint8_t mode) {
+	(void)pin;
+	(void)mode;
+}
+
+
+void digitalWrite(uint8_t pin, uint8_t val) {
+	if(pin >= NUM_PINS) return;
+	host_pin[pin] = val;
+	hostRecordOutput(HOST_PIN, pin, val);
+}
+
+
+int digitalRead(uint8_t pin) {
+	if(pin >= NUM_PINS) return LOW;
+	return host_pin[pin];
+}
+
+
+void analogWrite(uint8_t pin, int val) {
+	if(pin >= NUM_PINS) return;
+	if(val < 0) val = 0;
+	if(val > 255) val = 255;
+	host_pwm[pin] = val;
+	hostRecordOutput(HOST_PWM, pin, val);
+}
+
+
+static int hostAnalogValue(uint8_t pin, unsigned long us) {
+
+	int val = host_analog[pin];
+	if(host_analog_src != NULL) val = host_analog_src(pin, us / 1000UL);
+
+	if(val < 0) val = 0;
+	if(val > 1023) val = 1023;
+	return val;
+
+}
+
+
+int analogRead(uint8_t pin) {
+
+	if(pin >= NUM_PINS) return 0;
+
+	host_analog_reads++;
+
+	// the adc takes about 100us on the robot
+	host_us += 100;
+
+	return hostAnalogValue(pin, host_us);
+
+}
+
+
+// -- all of the conversions the adc would have done by now. they don't
+// take any time, they happen in the background on the robot
+static void hostAdcRun() {
+
+	if(host_adc_num == 0) return;
+
+	// a long jump in time would only overflow the buffer anyway
+	if(host_us > host_adc_next + HAL_ADC_BUFFER * HOST_ADC_PERIOD) {
+		unsigned long skip = (host_us - host_adc_next) / HOST_ADC_PERIOD - HAL_ADC_BUFFER;
+		host_adc_overflows += skip;
+		host_adc_cur = (host_adc_cur + skip) % host_adc_num;
+		host_adc_next += skip * HOST_ADC_PERIOD;
+	}
+
+	while(host_adc_next <= host_us) {
+
+		uint8_t index = host_adc_cur;
+		uint16_t val = hostAnalogValue(host_adc_pins[index], host_adc_next);
+
+		if(++host_adc_cur >= host_adc_num) host_adc_cur = 0;
+		host_adc_next += HOST_ADC_PERIOD;
+
+		uint8_t next = (host_adc_head + 1) & (HAL_ADC_BUFFER-1);
+
+		if(next == host_adc_tail) {
+			host_adc_overflows++;
+			continue;
+		}
+
+		host_adc_buf[host_adc_head] = ((uint16_t)index << 12) | val;
+		host_adc_head = next;
+
+	}
+
+}
+
+
+bool hal_adcStart(const uint8_t *pins, uint8_t num) {
+
+	hal_adcStop();
+
+	if(num == 0 || num > HAL_ADC_PINS) return false;
+
+	for(uint8_t i=0; i<num; i++) {
+		host_adc_pins[i] = (pins[i] < A0) ? pins[i] + A0 : pins[i];
+	}
+
+	host_adc_num = num;
+	host_adc_cur = 0;
+	host_adc_head = 0;
+	host_adc_tail = 0;
+	host_adc_next = (host_us / HOST_ADC_PERIOD + 1) * HOST_ADC_PERIOD;
+
+	return true;
+
+}
+
+
+void hal_adcStop() {
+	host_adc_num = 0;
+}
+
+
+bool hal_adcRead(uint8_t *index, uint16_t *val) {
+
+	hostAdcRun();
+
+	if(host_adc_tail == host_adc_head) return false;
+
+	uint16_t entry = host_adc_buf[host_adc_tail];
+	host_adc_tail = (host_adc_tail + 1) & (HAL_ADC_BUFFER-1);
+
+	*index = entry >> 12;
+	*val = entry & 0x3FF;
+
+	return true;
+
+}
+
+
+uint16_t hal_adcOverflows() {
+	hostAdcRun();
+	return host_adc_overflows;
+}
+
+
+void hostSetAnalog(uint8_t pin, int val) {
+	if(pin >= NUM_PINS) return;
+	host_analog[pin] = val;
+}
+
+
+void hostSetAnalogSource(HostAnalogSource src) {
+	host_analog_src = src;
+}
+
+
+unsigned long hostGetAnalogReads() {
+	return host_analog_reads;
+}
+
+
+long random(long howbig) {
+	if(howbig <= 0) return 0;
+	return rand() % howbig;
+}
+
+
+long random(long howsmall, long howbig) {
+	if(howsmall >= howbig) return howsmall;
+	return random(howbig - howsmall) + howsmall;
+}
+
+
+void randomSeed(unsigned long seed) {
+	srand(seed);
+}
+
+
+/**
+ * Outputs
+ */
+
+void hostSetTrace(FILE *f) {
+	host_trace = f;
+}
+
+
+void hostRecordOutput(uint8_t kind, int pin, int val) {
+
+	if(kind >= HOST_OUTPUTS) return;
+
+	host_writes[kind]++;
+
+	if(host_trace != NULL) {
+		fprintf(host_trace, "%lu.%03lu %s %d %d\n", host_us/1000UL, host_us%1000UL, host_output_names[kind], pin, val);
+	}
+
+}
+
+
+int hostGetPin(uint8_t pin) {
+	if(pin >= NUM_PINS) return 0;
+	return host_pin[pin];
+}
+
+
+int hostGetPwm(uint8_t pin) {
+	if(pin >= NUM_PINS) return 0;
+	return host_pwm[pin];
+}
+
+
+int hostGetServo(uint8_t pin) {
+	if(pin >= NUM_PINS) return -1;
+	return host_servo[pin];
+}
+
+
+unsigned long hostGetWrites(uint8_t kind) {
+	if(kind >= HOST_OUTPUTS) return 0;
+	return host_writes[kind];
+}
+
+
+void hostResetWrites() {
+	for(uint8_t i=0; i<HOST_OUTPUTS; i++) {
+		host_writes[i] = 0;
+	}
+}
+
+
+/**
+ * Servo
+ */
+
+Servo::Servo() {
+	pin = -1;
+	us = DEFAULT_PULSE_WIDTH;
+	min_us = MIN_PULSE_WIDTH;
+	max_us = MAX_PULSE_WIDTH;
+}
+
+
+uint8_t Servo::attach(int p) {
+	return attach(p, MIN_PULSE_WIDTH, MAX_PULSE_WIDTH);
+}
+
+
+uint8_t Servo::attach(int p, int mn, int mx) {
+	if(p < 0 || p >= NUM_PINS) return 0;
+	pin = p;
+	min_us = mn;
+	max_us = mx;
+	host_servo[pin] = us;
+	return 1;
+}
+
+
+void Servo::detach() {
+	if(pin < 0) return;
+	host_servo[pin] = -1;
+	pin = -1;
+}
+
+
+void Servo::write(int value) {
+
+	// like the real one, small values are degrees and big ones are us
+	if(value < MIN_PULSE_WIDTH) {
+		if(value < 0) value = 0;
+		if(value > 180) value = 180;
+		value = min_us + (long)value * (max_us - min_us) / 180;
+	}
+
+	writeMicroseconds(value);
+
+}
+
+
+void Servo::writeMicroseconds(int value) {
+
+	if(value < min_us) value = min_us;
+	if(value > max_us) value = max_us;
+	us = value;
+
+	if(pin < 0) return;
+
+	host_servo[pin] = us;
+	hostRecordOutput(HOST_SERVO, pin, us);
+
+}
+
+
+int Servo::read() {
+	return (long)(us - min_us) * 180 / (max_us - min_us);
+}
+
+
+/**
+ * Speaker
+ */
+
+// -- writes out the samples up to now, before anything changes
+static void hostAudioRender() {
+
+	if(host_audio == NULL) return;
+
+	while(true) {
+
+		unsigned long us = host_audio_samples * (1000000UL / SYNTH_RATE);
+		if(us >= host_us) break;
+
+		uint8_t out = 0;
+
+		if(host_tone_pin >= 0 && us >= host_tone_start && us < host_tone_end) {
+			if(!host_synth_on) {
+				out = (((us - host_tone_start) / host_tone_half) & 1) ? 0 : 255;
+			} else if(host_voice.steps > 0) {
+				out = synthNext(&host_voice);
+				if(host_audio_bits) out = synthBit(&host_voice, out) ? 255 : 0;
+			}
+		}
+
+		fputc(out, host_audio);
+		host_audio_samples++;
+
+	}
+
+}
+
+
+static void hostWrite32(FILE *f, uint32_t val) {
+	for(uint8_t i=0; i<4; i++) fputc((val >> (i*8)) & 0xFF, f);
+}
+
+
+static void hostWavHeader(FILE *f, uint32_t samples) {
+
+	fwrite("RIFF", 1, 4, f);
+	hostWrite32(f, 36 + samples);
+	fwrite("WAVEfmt ", 1, 8, f);
+	hostWrite32(f, 16);
+	hostWrite32(f, 0x00010001); // pcm, mono
+	hostWrite32(f, SYNTH_RATE);
+	hostWrite32(f, SYNTH_RATE); // bytes per second
+	hostWrite32(f, 0x00080001); // 1 byte per sample, 8 bits
+	fwrite("data", 1, 4, f);
+	hostWrite32(f, samples);
+
+}
+
+
+bool hostAudioOpen(const char *path, bool bits) {
+
+	hostAudioClose();
+
+	host_audio = fopen(path, "wb");
+	if(host_audio == NULL) return false;
+
+	host_audio_bits = bits;
+	host_audio_samples = host_us / (1000000UL / SYNTH_RATE);
+	hostWavHeader(host_audio, 0);
+
+	return true;
+
+}
+
+
+void hostAudioClose() {
+
+	if(host_audio == NULL) return;
+
+	hostAudioRender();
+
+	// -- now that the length is known
+	uint32_t samples = ftell(host_audio) - 44;
+	fseek(host_audio, 0, SEEK_SET);
+	hostWavHeader(host_audio, samples);
+
+	fclose(host_audio);
+	host_audio = NULL;
+
+}
+
+
+// -- there's no timer 2 here, so nothing to work around
+void hal_analogWrite(uint8_t pin, int val) {
+	analogWrite(pin, val);
+}
+
+
+void hal_toneStart(uint8_t pin, uint16_t half_period, uint16_t duration) {
+
+	hal_toneStop();
+
+	if(half_period == 0 || duration == 0) return;
+
+	host_tone_pin = pin;
+	host_tone_start = host_us;
+	host_tone_end = host_us + duration * 1000UL;
+	host_tone_half = half_period;
+	host_synth_on = false;
+	hostRecordOutput(HOST_TONE, pin, half_period);
+
+}
+
+
+void hal_synthStart(uint8_t pin, const SynthChirp *chirp) {
+
+	hal_toneStop();
+
+	if(chirp->duration == 0 || chirp->volume == 0) return;
+
+	synthStart(&host_voice, chirp);
+
+	host_tone_pin = pin;
+	host_tone_start = host_us;
+	host_tone_end = host_us + (unsigned long)host_voice.steps * SYNTH_CONTROL * (1000000UL / SYNTH_RATE);
+	host_synth_on = true;
+	hostRecordOutput(HOST_CHIRP, pin, chirp->from);
+
+}
+
+
+void hal_toneStop() {
+
+	if(hal_tonePlaying()) hostRecordOutput(host_synth_on ? HOST_CHIRP : HOST_TONE, host_tone_pin, 0);
+
+	host_tone_pin = -1;
+
+}
+
+
+bool hal_tonePlaying() {
+
+	hostAudioRender();
+
+	if(host_tone_pin < 0) return false;
+
+	if(host_us >= host_tone_end) {
+		host_tone_pin = -1;
+		return false;
+	}
+
+	return true;
+
+}
+
+
+/**
+ * EEPROM
+ */
+
+uint8_t EEPROMClass::read(int addr) {
+	if(addr < 0 || addr >= HOST_EEPROM_SIZE) return 0xFF;
+	return host_eeprom[addr];
+}
+
+
+void EEPROMClass::write(int addr, uint8_t val) {
+
+	if(addr < 0 || addr >= HOST_EEPROM_SIZE) return;
+
+	// an eeprom write takes about 3.3ms on the robot
+	host_us += 3300;
+
+	host_eeprom[addr] = val;
+	hostRecordOutput(HOST_EEPROM, addr, val);
+
+}
+
+
+void hostEepromErase(uint8_t val) {
+	memset(host_eeprom, val, sizeof(host_eeprom));
+}
+
+
+bool hostEepromLoad(const char *path) {
+
+	FILE *f = fopen(path, "rb");
+	if(f == NULL) return false;
+
+	size_t n = fread(host_eeprom, 1, sizeof(host_eeprom), f);
+	fclose(f);
+
+	return n == sizeof(host_eeprom);
+
+}
+
+
+bool hostEepromSave(const char *path) {
+
+	FILE *f = fopen(path, "wb");
+	if(f == NULL) return false;
+
+	size_t n = fwrite(host_eeprom, 1, sizeof(host_eeprom), f);
+	fclose(f);
+
+	return n == sizeof(host_eeprom);
+
+}
+
+
+/**
+ * Serial
+ */
+
+size_t Print::write(const uint8_t *buf, size_t len) {
+	size_t n = 0;
+	while(len--) n += write(*buf++);
+	return n;
+}
+
+
+size_t Print::print(long n, int base) {
+
+	if(base == DEC && n < 0) {
+		size_t len = print('-');
+		return len + print((unsigned long)(-n), base);
+	}
+
+	return print((unsigned long)n, base);
+
+}
+
+
+size_t Print::print(unsigned long n, int base) {
+
+	char buf[8 * sizeof(long) + 1];
+	char *str = &buf[sizeof(buf) - 1];
+
+	if(base < 2) base = 10;
+	*str = '\0';
+
+	do {
+		unsigned long m = n;
+		n /= base;
+		char c = m - base * n;
+		*--str = c < 10 ? c + '0' : c + 'A' - 10;
+	} while(n);
+
+	return write(str);
+
+}
+
+
+size_t Print::print(double n, int digits) {
+	char buf[32];
+	snprintf(buf, sizeof(buf), "%.*f", digits, n);
+	return write(buf);
+}
+
+
+size_t HardwareSerial::write(uint8_t c) {
+	if(host_echo != NULL) fputc(c, host_echo);
+	return 1;
+}
+
+
+int HardwareSerial::available() {
+	return host_rx_len;
+}
+
+
+int HardwareSerial::read() {
+
+	if(host_rx_len == 0) return -1;
+
+	char c = host_rx[host_rx_head];
+	host_rx_head = (host_rx_head + 1) % HOST_SERIAL_SIZE;
+	host_rx_len--;
+
+	return (uint8_t)c;
+
+}
+
+
+int HardwareSerial::peek() {
+	if(host_rx_len == 0) return -1;
+	return (uint8_t)host_rx[host_rx_head];
+}
+
+
+void hostSerialInject(const char *data, size_t len) {
+
+	for(size_t i=0; i<len; i++) {
+		if(host_rx_len == HOST_SERIAL_SIZE) return; // full, like the real one
+		host_rx[(host_rx_head + host_rx_len) % HOST_SERIAL_SIZE] = data[i];
+		host_rx_len++;
+	}
+
+}
+
+
+void hostSetSerialEcho(FILE *f) {
+	host_echo = f;
+}
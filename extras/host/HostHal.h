@@ -0,0 +1,87 @@
+/**
+ * RoboBrrd Host Backend
+ * ---------------------
+ *
+ * Lets the library run on Linux, with a virtual clock, simulated
+ * EEPROM, scripted analog inputs and a record of all of the outputs.
+ * This is what RoboBrrdHal.h uses when ROBOBRRD_HOST is defined.
+ *
+ * Nothing here is real time. The clock only moves when the library
+ * waits (delay, delayMicroseconds), when you call hostAdvance, or by a
+ * tiny amount every time the clock is read (so busy loops that watch
+ * millis() still finish).
+ *
+ * Copyright (c) 2014 Erin Kennedy.
+ * Licensed under MIT License, see license.txt for more info.
+ */
+
+#ifndef _HOST_HAL_H_
+#define _HOST_HAL_H_
+
+#include <stdio.h>
+#include "Arduino.h"
+
+
+// -- clock
+void hostSetTime(unsigned long ms);
+void hostAdvance(unsigned long ms);
+void hostAdvanceMicros(unsigned long us);
+unsigned long hostMicros();
+
+// how long (us) each millis() / micros() call takes. 0 means the clock
+// only moves on delays, which will hang any loop waiting on millis()
+void hostSetReadCost(unsigned int us);
+
+
+// -- analog inputs
+// a source is asked for the value whenever the pin is read. without a
+// source the last value given to hostSetAnalog is returned
+typedef int (*HostAnalogSource)(uint8_t pin, unsigned long ms);
+
+void hostSetAnalog(uint8_t pin, int val);
+void hostSetAnalogSource(HostAnalogSource src);
+unsigned long hostGetAnalogReads(); // hal_analogRead only, not the background ones
+
+
+// -- outputs
+enum HostOutput {
+	HOST_PIN,
+	HOST_PWM,
+	HOST_SERVO,
+	HOST_EEPROM,
+	HOST_TONE, // val is the half period (us) when it starts, 0 when stopped early
+	HOST_CHIRP, // val is the frequency (Hz) it starts at, 0 when stopped early
+	HOST_OUTPUTS
+};
+
+// every output is written to the trace as "<ms> <kind> <pin> <val>"
+void hostSetTrace(FILE *f);
+
+int hostGetPin(uint8_t pin);
+int hostGetPwm(uint8_t pin);
+int hostGetServo(uint8_t pin); // us, or -1 when detached
+unsigned long hostGetWrites(uint8_t kind);
+void hostResetWrites();
+
+void hostRecordOutput(uint8_t kind, int pin, int val);
+
+
+// -- speaker
+// records what the speaker plays to an 8 bit WAV file at SYNTH_RATE, until
+// it's closed. chirps are the synth's samples (or with bits, the 1 bit
+// stream that goes to the pin) and tones are square waves
+bool hostAudioOpen(const char *path, bool bits);
+void hostAudioClose();
+
+
+// -- eeprom
+void hostEepromErase(uint8_t val); // a fresh chip is 0xFF
+bool hostEepromLoad(const char *path);
+bool hostEepromSave(const char *path);
+
+
+// -- serial
+void hostSerialInject(const char *data, size_t len);
+void hostSetSerialEcho(FILE *f); // where Serial writes go, NULL to drop them
+
+#endif
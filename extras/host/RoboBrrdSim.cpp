@@ -0,0 +1,364 @@
+/**
+ * RoboBrrd Simulator
+ * ------------------
+ *
+ * Runs the library on the host's virtual clock, as fast as it can go,
+ * following a script of light sensor changes and API messages. Every
+ * servo, led and eeprom write is printed as a trace, so two versions of
+ * the library can be compared with diff. A whole day takes seconds.
+ *
+ *   robobrrd_sim [-d ms] [-t ms] [-s seed] [-e eeprom.bin] [-q] [-v] script.txt
+ *
+ *   -d  how long to run for (default: until 10s after the last event)
+ *   -t  how often update() is called (default 10ms)
+ *   -s  random seed (default 1)
+ *   -e  eeprom file to start from (it's saved back at the end)
+ *   -q  don't print the trace, just the summary
+ *   -v  show what RoboBrrd prints on Serial (on stderr)
+ *
+ * Script
+ * ------
+ *
+ * One event per line, in time order. Times are in ms, and can have an
+ * h, m or s on the end instead. Lines starting with # are comments.
+ *
+ *   <time> ldr <left|right> <val>            set a light sensor reading
+ *   <time> ramp <left|right> <val> <ms>      slide it there over some time
+ *   <time> api <message>                     send an API message, eg. #B3,0!
+ *   <time> end                               stop here
+ *
+ * Copyright (c) 2014 Erin Kennedy.
+ * Licensed under MIT License, see license.txt for more info.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "RoboBrrd.h"
+
+
+RoboBrrd robobrrd;
+
+
+/**
+ * Script
+ */
+
+enum SimEventType {
+	SIM_LDR,
+	SIM_RAMP,
+	SIM_API,
+	SIM_END
+};
+
+struct SimEvent {
+	unsigned long time;
+	uint8_t type;
+	uint8_t pin;
+	int val;
+	unsigned long dur;
+	char msg[32];
+};
+
+#define SIM_MAX_EVENTS 4096
+
+static SimEvent events[SIM_MAX_EVENTS];
+static int num_events = 0;
+
+
+// -- "1500", "90s", "15m", "6h"
+static bool parseTime(const char *str, unsigned long *ms) {
+
+	char *end;
+	double t = strtod(str, &end);
+
+	if(end == str || t < 0) return false;
+
+	switch(*end) {
+		case '\0':
+		break;
+		case 's':
+			t *= 1000.0;
+		break;
+		case 'm':
+			t *= 60000.0;
+		break;
+		case 'h':
+			t *= 3600000.0;
+		break;
+		default:
+		return false;
+	}
+
+	*ms = (unsigned long)t;
+	return true;
+
+}
+
+
+static bool parsePin(const char *str, uint8_t *pin) {
+
+	// -- the library's default ldr pins
+	if(strcmp(str, "left") == 0) {
+		*pin = A0;
+	} else if(strcmp(str, "right") == 0) {
+		*pin = A1;
+	} else {
+		return false;
+	}
+
+	return true;
+
+}
+
+
+static bool loadScript(const char *path) {
+
+	FILE *f = fopen(path, "r");
+	if(f == NULL) {
+		fprintf(stderr, "can't open %s\n", path);
+		return false;
+	}
+
+	char line[128];
+	int line_num = 0;
+
+	while(fgets(line, sizeof(line), f) != NULL) {
+
+		line_num++;
+
+		char time_str[16], type[8], a[32], b[16], c[16];
+		int n = sscanf(line, "%15s %7s %31s %15s %15s", time_str, type, a, b, c);
+
+		if(n <= 0 || time_str[0] == '#') continue;
+
+		if(num_events == SIM_MAX_EVENTS) {
+			fprintf(stderr, "%s:%d: too many events\n", path, line_num);
+			break;
+		}
+
+		SimEvent *e = &events[num_events];
+		memset(e, 0, sizeof(SimEvent));
+		bool ok = parseTime(time_str, &e->time);
+
+		if(ok && n >= 2 && strcmp(type, "ldr") == 0) {
+			e->type = SIM_LDR;
+			ok = n >= 4 && parsePin(a, &e->pin);
+			e->val = atoi(b);
+		} else if(ok && n >= 2 && strcmp(type, "ramp") == 0) {
+			e->type = SIM_RAMP;
+			ok = n >= 5 && parsePin(a, &e->pin) && parseTime(c, &e->dur);
+			e->val = atoi(b);
+		} else if(ok && n >= 2 && strcmp(type, "api") == 0) {
+			e->type = SIM_API;
+			ok = n >= 3;
+			snprintf(e->msg, sizeof(e->msg), "%s", a);
+		} else if(ok && n >= 2 && strcmp(type, "end") == 0) {
+			e->type = SIM_END;
+		} else {
+			ok = false;
+		}
+
+		if(!ok) {
+			fprintf(stderr, "%s:%d: don't understand: %s", path, line_num, line);
+			fclose(f);
+			return false;
+		}
+
+		if(num_events > 0 && e->time < events[num_events-1].time) {
+			fprintf(stderr, "%s:%d: events need to be in time order\n", path, line_num);
+			fclose(f);
+			return false;
+		}
+
+		num_events++;
+
+	}
+
+	fclose(f);
+	return true;
+
+}
+
+
+/**
+ * Light
+ */
+
+struct SimRamp {
+	int from;
+	int to;
+	unsigned long start;
+	unsigned long dur;
+};
+
+static SimRamp ramps[NUM_PINS];
+
+
+static int rampSource(uint8_t pin, unsigned long ms) {
+
+	SimRamp *r = &ramps[pin];
+
+	if(ms >= r->start + r->dur || r->dur == 0) return r->to;
+	if(ms <= r->start) return r->from;
+
+	return r->from + (long)(r->to - r->from) * (long)(ms - r->start) / (long)r->dur;
+
+}
+
+
+static void setLight(uint8_t pin, int val, unsigned long start, unsigned long dur) {
+
+	SimRamp *r = &ramps[pin];
+
+	r->from = rampSource(pin, start);
+	r->to = val;
+	r->start = start;
+	r->dur = dur;
+
+}
+
+
+/**
+ * API
+ */
+
+static void received_action(char action, char cmd, uint8_t key, uint16_t val, char delim) {
+	robobrrd.parse_action(0, action, cmd, key, val, delim);
+}
+
+
+static void transmit_complete() {
+}
+
+
+// -- what serialEvent() does in the sketches
+static void serialEvent() {
+	while(Serial.available()) {
+		char c = Serial.read();
+		if(robobrrd.apiModeHw()) robobrrd.promulgate_hw.organize_message(c);
+	}
+}
+
+
+/**
+ * Main
+ */
+
+static void usage() {
+	fprintf(stderr, "usage: robobrrd_sim [-d ms] [-t ms] [-s seed] [-e eeprom.bin] [-q] [-v] script.txt\n");
+}
+
+
+int main(int argc, char **argv) {
+
+	unsigned long duration = 0;
+	unsigned long tick = 10;
+	unsigned long seed = 1;
+	const char *eeprom_path = NULL;
+	const char *script_path = NULL;
+	bool quiet = false;
+	bool verbose = false;
+
+	for(int i=1; i<argc; i++) {
+
+		bool has_arg = (i+1 < argc);
+
+		if(strcmp(argv[i], "-d") == 0 && has_arg) {
+			if(!parseTime(argv[++i], &duration)) { usage(); return 1; }
+		} else if(strcmp(argv[i], "-t") == 0 && has_arg) {
+			if(!parseTime(argv[++i], &tick) || tick == 0) { usage(); return 1; }
+		} else if(strcmp(argv[i], "-s") == 0 && has_arg) {
+			seed = strtoul(argv[++i], NULL, 10);
+		} else if(strcmp(argv[i], "-e") == 0 && has_arg) {
+			eeprom_path = argv[++i];
+		} else if(strcmp(argv[i], "-q") == 0) {
+			quiet = true;
+		} else if(strcmp(argv[i], "-v") == 0) {
+			verbose = true;
+		} else if(argv[i][0] != '-' && script_path == NULL) {
+			script_path = argv[i];
+		} else {
+			usage();
+			return 1;
+		}
+
+	}
+
+	if(script_path == NULL) {
+		usage();
+		return 1;
+	}
+
+	if(!loadScript(script_path)) return 1;
+
+	if(duration == 0 && num_events > 0) duration = events[num_events-1].time + 10000;
+
+
+	// -- set up the simulated robot
+	randomSeed(seed);
+	hostSetTime(0);
+	if(eeprom_path != NULL) hostEepromLoad(eeprom_path);
+	if(!quiet) hostSetTrace(stdout);
+	if(verbose) hostSetSerialEcho(stderr);
+
+	setLight(A0, 512, 0, 0);
+	setLight(A1, 512, 0, 0);
+	hostSetAnalogSource(rampSource);
+
+	robobrrd.init();
+	robobrrd.promulgate_hw.set_rx_callback(received_action);
+	robobrrd.promulgate_hw.set_tx_callback(transmit_complete);
+
+
+	// -- and go
+	int next_event = 0;
+	unsigned long updates = 0;
+	unsigned long now = millis();
+
+	while(now < duration) {
+
+		while(next_event < num_events && events[next_event].time <= now) {
+
+			SimEvent *e = &events[next_event++];
+
+			switch(e->type) {
+				case SIM_LDR:
+					setLight(e->pin, e->val, now, 0);
+				break;
+				case SIM_RAMP:
+					setLight(e->pin, e->val, now, e->dur);
+				break;
+				case SIM_API:
+					hostSerialInject(e->msg, strlen(e->msg));
+				break;
+				case SIM_END:
+					duration = now;
+				break;
+			}
+
+		}
+
+		if(now >= duration) break;
+
+		robobrrd.update();
+		serialEvent();
+		updates++;
+
+		// -- sleep until the next tick, unless update() took longer than that
+		unsigned long next = (now / tick + 1) * tick;
+		if(hostMicros() < next * 1000UL) hostSetTime(next);
+		now = hostMicros() / 1000UL;
+
+	}
+
+	if(eeprom_path != NULL) hostEepromSave(eeprom_path);
+
+	fprintf(stderr, "simulated %lu ms, %lu updates\n", now, updates);
+	fprintf(stderr, "servo writes: %lu, pwm writes: %lu, pin writes: %lu, eeprom writes: %lu, analog reads: %lu\n",
+		hostGetWrites(HOST_SERVO), hostGetWrites(HOST_PWM), hostGetWrites(HOST_PIN),
+		hostGetWrites(HOST_EEPROM), hostGetAnalogReads());
+
+	return 0;
+
+}
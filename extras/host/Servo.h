@@ -0,0 +1,46 @@
+/**
+ * Host Servo
+ * ----------
+ *
+ * Remembers where it was told to go, and records every write with
+ * HostHal.
+ *
+ * Copyright (c) 2014 Erin Kennedy.
+ * Licensed under MIT License, see license.txt for more info.
+ */
+
+#ifndef _HOST_SERVO_H_
+#define _HOST_SERVO_H_
+
+#include "Arduino.h"
+
+#define MIN_PULSE_WIDTH 544
+#define MAX_PULSE_WIDTH 2400
+#define DEFAULT_PULSE_WIDTH 1500
+
+class Servo {
+
+	public:
+
+		Servo();
+
+		uint8_t attach(int pin);
+		uint8_t attach(int pin, int min, int max);
+		void detach();
+		bool attached() { return pin >= 0; }
+
+		void write(int value);
+		void writeMicroseconds(int value);
+		int read();
+		int readMicroseconds() { return us; }
+
+	private:
+
+		int pin;
+		int us;
+		int min_us;
+		int max_us;
+
+};
+
+#endif
@@ -0,0 +1,28 @@
+/**
+ * Host pgmspace
+ * -------------
+ *
+ * There's only one kind of memory on the host, so PROGMEM is a normal
+ * const array and the reads are normal reads.
+ */
+
+#ifndef _HOST_PGMSPACE_H_
+#define _HOST_PGMSPACE_H_
+
+#include <stdint.h>
+#include <string.h>
+
+#define PROGMEM
+#define PGM_P const char *
+#define PSTR(s) (s)
+
+#define pgm_read_byte(addr) (*(const uint8_t *)(addr))
+#define pgm_read_word(addr) (*(const uint16_t *)(addr))
+#define pgm_read_dword(addr) (*(const uint32_t *)(addr))
+#define pgm_read_float(addr) (*(const float *)(addr))
+#define pgm_read_ptr(addr) (*(void * const *)(addr))
+
+#define memcpy_P memcpy
+#define strlen_P strlen
+
+#endif
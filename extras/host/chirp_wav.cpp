@@ -0,0 +1,116 @@
+/**
+ * Chirp WAV
+ * ---------
+ *
+ * Plays chirps (or a melody) through the library on the host and writes
+ * what the speaker would play to a WAV file, to listen to or look at.
+ *
+ *   chirp_wav [-b] [-m melody] out.wav [from:to:ms[:wave[:gap]] ...]
+ *
+ *   -b  write the 1 bit stream that goes to the pin, instead of the
+ *       samples it's made from
+ *   -m  play one of the built in melodies (see RoboBrrd::Melody)
+ *
+ * With no chirps and no melody, it plays tweet(). Waves are 0 sine,
+ * 1 triangle, 2 square and 3 saw.
+ *
+ * Copyright (c) 2014 Erin Kennedy.
+ * Licensed under MIT License, see license.txt for more info.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "RoboBrrd.h"
+
+
+RoboBrrd robobrrd;
+
+
+static void usage() {
+	fprintf(stderr, "usage: chirp_wav [-b] [-m melody] out.wav [from:to:ms[:wave[:gap]] ...]\n");
+}
+
+
+int main(int argc, char **argv) {
+
+	bool bits = false;
+	int melody = -1;
+	const char *path = NULL;
+	int first_chirp = argc;
+
+	for(int i=1; i<argc; i++) {
+
+		if(strcmp(argv[i], "-b") == 0) {
+			bits = true;
+		} else if(strcmp(argv[i], "-m") == 0 && i+1 < argc) {
+			melody = atoi(argv[++i]);
+		} else if(argv[i][0] != '-') {
+			path = argv[i];
+			first_chirp = i+1;
+			break;
+		} else {
+			usage();
+			return 1;
+		}
+
+	}
+
+	if(path == NULL) {
+		usage();
+		return 1;
+	}
+
+	hostSetAnalog(A0, 512);
+	hostSetAnalog(A1, 512);
+
+	robobrrd.init();
+	robobrrd.stopTone();
+
+	if(!hostAudioOpen(path, bits)) {
+		fprintf(stderr, "can't open %s\n", path);
+		return 1;
+	}
+
+	unsigned long start = millis();
+
+	if(melody >= 0) {
+		robobrrd.playMelody(melody);
+	}
+
+	for(int i=first_chirp; i<argc; i++) {
+
+		unsigned int from = 0, to = 0, ms = 0, wave = SYNTH_SINE, gap = 0;
+
+		if(sscanf(argv[i], "%u:%u:%u:%u:%u", &from, &to, &ms, &wave, &gap) < 3) {
+			fprintf(stderr, "don't understand: %s\n", argv[i]);
+			return 1;
+		}
+
+		// -- the queue is short, so one at a time
+		while(robobrrd.isTonePlaying()) {
+			robobrrd.update();
+			hostAdvance(1);
+		}
+
+		robobrrd.playChirp(from, to, ms, wave, gap);
+
+	}
+
+	if(melody < 0 && first_chirp >= argc) {
+		robobrrd.tweet();
+	}
+
+	while(robobrrd.isTonePlaying()) {
+		robobrrd.update();
+		hostAdvance(1);
+	}
+
+	hostAudioClose();
+
+	fprintf(stderr, "%lu ms of sound, %lu tones, %lu chirps, %u dropped\n", millis() - start,
+		hostGetWrites(HOST_TONE), hostGetWrites(HOST_CHIRP), robobrrd.getToneOverflows());
+
+	return 0;
+
+}
@@ -0,0 +1,90 @@
+/**
+ * Dither Check
+ * ------------
+ *
+ * Sets every 12 bit level on the eyes with dithering on, runs update()
+ * for a while, and checks that the average of what was written to the
+ * pwm pins comes out at that level. Exits with 1 if any level is off.
+ *
+ *   g++ -std=gnu++98 -O2 -DROBOBRRD_HOST \
+ *       -Iextras/host -I. -I<path to Streaming> -I<path to Promulgate> \
+ *       extras/host/dither_check.cpp RoboBrrd.cpp extras/host/HostHal.cpp \
+ *       <path to Promulgate>/Promulgate.cpp -o dither_check
+ *
+ * Copyright (c) 2014 Erin Kennedy.
+ * Licensed under MIT License, see license.txt for more info.
+ */
+
+#include <stdio.h>
+
+#include "RoboBrrd.h"
+
+RoboBrrd robobrrd;
+
+// -- the library's default led pins (red, green, blue)
+static const uint8_t led_pins[3] = { 3, 6, 5 };
+
+// -- frames averaged for each level, a multiple of 16 so it's exact
+static const uint16_t FRAMES = 256;
+
+
+int main() {
+
+	hostEepromErase(0);
+	robobrrd.enableLightSensors(false);
+	robobrrd.init();
+
+	// -- straight through, so what goes in should be what comes out
+	robobrrd.setEyesGamma(false);
+	robobrrd.setMaxBrightness(1.0);
+	robobrrd.setEyesDither(true);
+
+	double worst = 0.0;
+	uint16_t worst_level = 0;
+	unsigned long failures = 0;
+
+	for(uint16_t level=0; level<4096; level++) {
+
+		// -- a different level on each channel
+		uint16_t want[3] = { level, (uint16_t)(4095 - level), (uint16_t)((level * 7) % 4096) };
+		unsigned long sum[3] = { 0, 0, 0 };
+
+		robobrrd.setEyesRGB12(want[0], want[1], want[2]);
+
+		for(uint16_t f=0; f<FRAMES; f++) {
+			hostAdvance(1);
+			robobrrd.update();
+			for(uint8_t i=0; i<3; i++) {
+				sum[i] += hostGetPwm(led_pins[i]);
+			}
+		}
+
+		for(uint8_t i=0; i<3; i++) {
+
+			double got = sum[i] * 16.0 / FRAMES;
+			double err = got - want[i];
+			if(err < 0) err = -err;
+
+			// -- the very top can't go past 255
+			double allowed = (want[i] > 4080) ? 16.0 : 0.5;
+
+			if(err > allowed) {
+				if(failures < 10) printf("level %u: got %.2f\n", want[i], got);
+				failures++;
+			}
+
+			if(want[i] <= 4080 && err > worst) {
+				worst = err;
+				worst_level = want[i];
+			}
+
+		}
+
+	}
+
+	printf("worst error %.3f (of 4095) at level %u, %lu failures\n", worst, worst_level, failures);
+	printf("%s\n", failures == 0 ? "PASS" : "FAIL");
+
+	return failures == 0 ? 0 : 1;
+
+}
@@ -0,0 +1,260 @@
+/**
+ * Gesture Check
+ * -------------
+ *
+ * Plays the right wing wave with known positions, once blocking and once
+ * through update(), and checks the servo writes that come out: the right
+ * positions, in the right order, at the right times.
+ *
+ * Then it gives the right wing a speed and acceleration limit and moves
+ * it a long way, and checks the trapezoidal profile: no step faster than
+ * the speed limit, no change in step bigger than the acceleration limit,
+ * up to full speed and back down, and landing exactly on the target at
+ * about the time the profile says. Exits with 1 if anything is off.
+ *
+ *   g++ -std=gnu++98 -O2 -DROBOBRRD_HOST \
+ *       -Iextras/host -I. -I<path to Streaming> -I<path to Promulgate> \
+ *       extras/host/gesture_check.cpp RoboBrrd.cpp extras/host/HostHal.cpp \
+ *       <path to Promulgate>/Promulgate.cpp -o gesture_check
+ *
+ * Copyright (c) 2014 Erin Kennedy.
+ * Licensed under MIT License, see license.txt for more info.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "RoboBrrd.h"
+
+RoboBrrd robobrrd;
+
+// -- the library's default right wing pin, and the positions to use
+static const uint8_t rwing_pin = 10;
+static const uint8_t home = 90;
+static const uint8_t up = 40;
+static const uint8_t down = 140;
+
+// -- gesture_rwing_wave: up, down, twice more, then home
+static const uint8_t want_pos[] = { up, down, up, down, up, down, home };
+static const unsigned long want_ms[] = { 0, 150, 300, 450, 600, 750, 900 };
+static const uint8_t WANT = sizeof(want_pos);
+
+// -- how far off (ms) a step can be, for the time the library spends
+// reading the clock
+static const unsigned long SLACK = 2;
+
+// -- the speed limited move: deg/s, deg/s^2, and where it goes
+static const uint16_t max_speed = 180;
+static const uint16_t max_accel = 900;
+static const uint8_t far = 170;
+
+// -- the trajectory tick (ms), and how many ticks off the arrival can be
+static const double TICK = 20.0;
+static const double ARRIVAL_SLACK = 3;
+
+static const int MAX_WRITES = 200;
+
+
+// -- the same as the Servo library's write()
+static int servoMicros(uint8_t deg) {
+	return 544 + ((long)deg * (2400 - 544)) / 180;
+}
+
+
+// -- the right wing's servo writes from a trace, with their times
+static int readWrites(FILE *trace, double *ms, int *us) {
+
+	int n = 0;
+	char line[80];
+
+	rewind(trace);
+
+	while(fgets(line, sizeof(line), trace) && n < MAX_WRITES) {
+
+		char kind[16];
+		int pin;
+
+		if(sscanf(line, "%lf %15s %d %d", &ms[n], kind, &pin, &us[n]) != 4) continue;
+		if(strcmp(kind, "servo") != 0 || pin != rwing_pin) continue;
+
+		n++;
+
+	}
+
+	return n;
+
+}
+
+
+static bool checkGesture(const char *name, FILE *trace) {
+
+	bool pass = true;
+	double ms[MAX_WRITES];
+	int us[MAX_WRITES];
+
+	int got = readWrites(trace, ms, us);
+
+	for(int i=0; i<got; i++) {
+
+		unsigned long at = (unsigned long)ms[i] - (unsigned long)ms[0];
+
+		if(i >= WANT) {
+			printf("%s: extra write %d us at %lu ms\n", name, us[i], at);
+			pass = false;
+			continue;
+		}
+
+		unsigned long late = (at > want_ms[i]) ? at - want_ms[i] : want_ms[i] - at;
+
+		if(us[i] != servoMicros(want_pos[i]) || late > SLACK) {
+			printf("%s: step %d was %d us at %lu ms, wanted %d us at %lu ms\n", name, i,
+				us[i], at, servoMicros(want_pos[i]), want_ms[i]);
+			pass = false;
+		}
+
+	}
+
+	if(got < WANT) {
+		printf("%s: only %d of %u writes\n", name, got, WANT);
+		pass = false;
+	}
+
+	printf("%s: %d writes, %s\n", name, got, pass ? "ok" : "wrong");
+
+	return pass;
+
+}
+
+
+static bool checkProfile(FILE *trace, double start) {
+
+	bool pass = true;
+	double ms[MAX_WRITES];
+	int us[MAX_WRITES];
+
+	int got = readWrites(trace, ms, us);
+
+	// -- the limits in us per tick (and per tick per tick), the same way
+	// setServoSpeed works them out. the writes are rounded to whole us,
+	// so a step can be off by 1 and a change in step by 2
+	double range = 2400 - 544;
+	double v = max_speed * range / 180.0 * TICK / 1000.0;
+	double a = max_accel * range / 180.0 * TICK * TICK / 1000000.0;
+
+	int from = servoMicros(home);
+	int to = servoMicros(far);
+	double dist = to - from;
+
+	// -- up to speed, cruise, and brake, or a triangle if it's too short
+	double ticks = (dist >= v*v/a) ? dist/v + v/a : 2.0 * sqrt(dist/a);
+	double want_at = ticks * TICK;
+
+	int last = from;
+	int last_step = 0;
+	int fastest = 0;
+
+	for(int i=0; i<got; i++) {
+
+		int step = us[i] - last;
+
+		if(step < 0 || step > v + 1) {
+			printf("profile: write %d moved %d us, the limit is %.1f\n", i, step, v);
+			pass = false;
+		}
+
+		if(fabs((double)(step - last_step)) > a + 2) {
+			printf("profile: write %d changed speed by %d us, the limit is %.1f\n", i, step - last_step, a);
+			pass = false;
+		}
+
+		if(step > fastest) fastest = step;
+
+		last = us[i];
+		last_step = step;
+
+	}
+
+	if(got == 0 || us[got-1] != to) {
+		printf("profile: ended at %d us, wanted %d us\n", got ? us[got-1] : -1, to);
+		pass = false;
+	}
+
+	if(fastest < v - 1) {
+		printf("profile: only got up to %d us a tick, wanted %.1f\n", fastest, v);
+		pass = false;
+	}
+
+	double at = got ? ms[got-1] - start : 0;
+
+	if(fabs(at - want_at) > ARRIVAL_SLACK * TICK) {
+		printf("profile: arrived after %.0f ms, wanted about %.0f ms\n", at, want_at);
+		pass = false;
+	}
+
+	printf("profile: %d writes, arrived after %.0f ms (about %.0f), %s\n", got, at, want_at, pass ? "ok" : "wrong");
+
+	return pass;
+
+}
+
+
+int main() {
+
+	bool pass = true;
+
+	hostEepromErase(0xFF);
+	robobrrd.enableLightSensors(false);
+	robobrrd.init();
+	robobrrd.setServoDefaults(RoboBrrd::RWING_SERVO, home, up, down);
+
+	// -- blocking
+	FILE *trace = tmpfile();
+	hostSetTrace(trace);
+
+	robobrrd.playGesture(RoboBrrd::GESTURE_RWING_WAVE);
+
+	hostSetTrace(NULL);
+	if(!checkGesture("blocking", trace)) pass = false;
+	fclose(trace);
+
+	// -- in the background
+	robobrrd.setAsyncMotion(true);
+
+	trace = tmpfile();
+	hostSetTrace(trace);
+
+	robobrrd.playGesture(RoboBrrd::GESTURE_RWING_WAVE);
+
+	for(int i=0; i<2000; i++) {
+		robobrrd.update();
+		hostAdvance(1);
+	}
+
+	hostSetTrace(NULL);
+	if(!checkGesture("async", trace)) pass = false;
+	fclose(trace);
+
+	// -- speed limited, from home (where the wave ended) to far
+	robobrrd.setServoSpeed(RoboBrrd::RWING_SERVO, max_speed, max_accel);
+
+	trace = tmpfile();
+	hostSetTrace(trace);
+
+	double start = hostMicros() / 1000.0;
+	robobrrd.servoMove(RoboBrrd::RWING_SERVO, far, 0);
+
+	for(int i=0; i<2000; i++) {
+		robobrrd.update();
+		hostAdvance(1);
+	}
+
+	hostSetTrace(NULL);
+	if(!checkProfile(trace, start)) pass = false;
+	fclose(trace);
+
+	printf("%s\n", pass ? "PASS" : "FAIL");
+
+	return pass ? 0 : 1;
+
+}
@@ -0,0 +1,170 @@
+/**
+ * HSI Benchmark
+ * -------------
+ *
+ * Checks RoboBrrd::hsi2rgb() against the original float version over
+ * the whole colour wheel, checks that rgb2hsi() gets back to the same
+ * colour, and times hsi2rgb() and the float version.
+ *
+ *   g++ -std=gnu++98 -O2 -DROBOBRRD_HOST \
+ *       -Iextras/host -I. -I<path to Streaming> -I<path to Promulgate> \
+ *       extras/host/hsi_bench.cpp RoboBrrd.cpp extras/host/HostHal.cpp \
+ *       <path to Promulgate>/Promulgate.cpp -o hsi_bench
+ *
+ * The times are for the host, of course. On x86 they are also given in
+ * cycles (from the time stamp counter). The float version on the robot
+ * is around a millisecond, because there's no fpu.
+ *
+ * Copyright (c) 2014 Erin Kennedy.
+ * Licensed under MIT License, see license.txt for more info.
+ */
+
+#include <stdio.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+	#include <x86intrin.h>
+	#define HAVE_TSC 1
+#endif
+
+#include "RoboBrrd.h"
+
+
+// -- the float version, as it was
+static void hsi2rgbFloat(float H, float S, float I, int *rgb) {
+
+	int r, g, b;
+	H = fmod(H,360);
+	H = 3.14159*H/(float)180;
+	S = S>0?(S<1?S:1):0;
+	I = I>0?(I<1?I:1):0;
+
+	if(H < 2.09439) {
+		r = 255*I/3*(1+S*cos(H)/cos(1.047196667-H));
+		g = 255*I/3*(1+S*(1-cos(H)/cos(1.047196667-H)));
+		b = 255*I/3*(1-S);
+	} else if(H < 4.188787) {
+		H = H - 2.09439;
+		g = 255*I/3*(1+S*cos(H)/cos(1.047196667-H));
+		b = 255*I/3*(1+S*(1-cos(H)/cos(1.047196667-H)));
+		r = 255*I/3*(1-S);
+	} else {
+		H = H - 4.188787;
+		b = 255*I/3*(1+S*cos(H)/cos(1.047196667-H));
+		r = 255*I/3*(1+S*(1-cos(H)/cos(1.047196667-H)));
+		g = 255*I/3*(1-S);
+	}
+
+	rgb[0]=r;
+	rgb[1]=g;
+	rgb[2]=b;
+
+}
+
+
+static double nowNs() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+
+static unsigned long long nowCycles() {
+#ifdef HAVE_TSC
+	return __rdtsc();
+#else
+	return 0;
+#endif
+}
+
+
+int main() {
+
+	// -- accuracy
+	int max_err = 0;
+	unsigned long off_by_one = 0;
+	unsigned long total = 0;
+
+	for(uint16_t h=0; h<RoboBrrd::HSI_HUE_STEPS; h++) {
+		for(uint16_t s=0; s<=255; s+=5) {
+			for(uint16_t i=0; i<=255; i+=5) {
+
+				uint8_t fixed[3];
+				int ref[3];
+
+				RoboBrrd::hsi2rgb(h, s, i, fixed);
+				hsi2rgbFloat(h/8.0, s/255.0, i/255.0, ref);
+
+				for(uint8_t c=0; c<3; c++) {
+					int err = abs((int)fixed[c] - ref[c]);
+					if(err > max_err) max_err = err;
+					if(err == 1) off_by_one++;
+					total++;
+				}
+
+			}
+		}
+	}
+
+	printf("accuracy: max error %d, %.2f%% of channels off by one (%lu channels)\n",
+		max_err, 100.0*off_by_one/total, total);
+
+
+	// -- rgb -> hsi -> rgb, for every colour that hsi can show (r+g+b <= 255)
+	int max_trip = 0;
+	unsigned long trips = 0;
+
+	for(uint16_t r=0; r<=255; r++) {
+		for(uint16_t g=0; r+g<=255; g++) {
+			for(uint16_t b=0; r+g+b<=255; b++) {
+
+				uint16_t h = 0;
+				uint8_t s, i, back[3];
+
+				RoboBrrd::rgb2hsi(r, g, b, &h, &s, &i);
+				RoboBrrd::hsi2rgb(h, s, i, back);
+
+				int err = max(abs((int)back[0] - r), max(abs((int)back[1] - g), abs((int)back[2] - b)));
+				if(err > max_trip) max_trip = err;
+				trips++;
+
+			}
+		}
+	}
+
+	printf("round trip: max error %d (%lu colours)\n", max_trip, trips);
+
+
+	// -- speed
+	const unsigned long runs = 2000000;
+	volatile uint8_t sink = 0;
+
+	double t0 = nowNs();
+	unsigned long long c0 = nowCycles();
+	for(unsigned long n=0; n<runs; n++) {
+		uint8_t rgb[3];
+		RoboBrrd::hsi2rgb(n % RoboBrrd::HSI_HUE_STEPS, 200, 180, rgb);
+		sink += rgb[0];
+	}
+	unsigned long long c1 = nowCycles();
+	double t1 = nowNs();
+
+	for(unsigned long n=0; n<runs; n++) {
+		int rgb[3];
+		hsi2rgbFloat((n % RoboBrrd::HSI_HUE_STEPS)/8.0, 200/255.0, 180/255.0, rgb);
+		sink += rgb[0];
+	}
+	unsigned long long c2 = nowCycles();
+	double t2 = nowNs();
+
+	printf("fixed: %.1f ns", (t1-t0)/runs);
+	if(c1 != c0) printf(", %.0f cycles", (double)(c1-c0)/runs);
+	printf(" per conversion\n");
+
+	printf("float: %.1f ns", (t2-t1)/runs);
+	if(c2 != c1) printf(", %.0f cycles", (double)(c2-c1)/runs);
+	printf(" per conversion\n");
+
+	return 0;
+
+}
@@ -0,0 +1,98 @@
+/**
+ * Light Sensor Glitch Check
+ * -------------------------
+ *
+ * Calibrates the light sensors, then makes the left one read dark for
+ * exactly one sample. None of the handlers should be called for that.
+ * After that a hand over the sensor (dark for a second) should call the
+ * dark handler, and the normal one once it's gone. Exits with 1 if
+ * either is wrong.
+ *
+ *   g++ -std=gnu++98 -O2 -DROBOBRRD_HOST \
+ *       -Iextras/host -I. -I<path to Streaming> -I<path to Promulgate> \
+ *       extras/host/ldr_glitch_check.cpp RoboBrrd.cpp extras/host/HostHal.cpp \
+ *       <path to Promulgate>/Promulgate.cpp -o ldr_glitch_check
+ *
+ * Copyright (c) 2014 Erin Kennedy.
+ * Licensed under MIT License, see license.txt for more info.
+ */
+
+#include <stdio.h>
+
+#include "RoboBrrd.h"
+
+RoboBrrd robobrrd;
+
+static unsigned int darks = 0;
+static unsigned int brights = 0;
+static unsigned int normals = 0;
+
+static void dark() { darks++; }
+static void bright() { brights++; }
+static void normal() { normals++; }
+
+
+static void run(unsigned long ms) {
+	for(unsigned long i=0; i<ms; i++) {
+		robobrrd.update();
+		hostAdvance(1);
+	}
+}
+
+
+int main() {
+
+	bool pass = true;
+
+	hostEepromErase(0xFF);
+	hostSetAnalog(A0, 600);
+	hostSetAnalog(A1, 600);
+
+	robobrrd.init();
+
+	for(uint8_t ch=0; ch<RoboBrrd::NUM_LDRS; ch++) {
+		robobrrd.setLdrDarkHandler(ch, dark);
+		robobrrd.setLdrBrightHandler(ch, bright);
+		robobrrd.setLdrNormalHandler(ch, normal);
+	}
+
+	run(6000);
+
+	if(robobrrd.getLightCalibration() != RoboBrrd::LIGHT_CALIBRATED) {
+		printf("didn't calibrate\n");
+		return 1;
+	}
+
+	// -- one bad sample: dark until the average moves, then back
+	uint16_t before = robobrrd.getLeftLDR();
+	hostSetAnalog(A0, 300);
+
+	unsigned long waited = 0;
+	while(robobrrd.getLeftLDR() == before && waited < 1000) {
+		robobrrd.update();
+		hostAdvance(1);
+		waited++;
+	}
+
+	hostSetAnalog(A0, 600);
+	run(3000);
+
+	printf("one sample glitch: %u dark, %u bright, %u normal\n", darks, brights, normals);
+	if(darks || brights || normals) pass = false;
+
+	// -- a hand over the sensor still counts
+	darks = brights = normals = 0;
+
+	hostSetAnalog(A0, 300);
+	run(1000);
+	hostSetAnalog(A0, 600);
+	run(3000);
+
+	printf("hand for 1s: %u dark, %u bright, %u normal\n", darks, brights, normals);
+	if(darks != 1 || brights || normals != 1) pass = false;
+
+	printf("%s\n", pass ? "PASS" : "FAIL");
+
+	return pass ? 0 : 1;
+
+}